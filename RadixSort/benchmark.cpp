@@ -11,11 +11,20 @@
 #include <locale>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <type_traits>
 
+#include "calibration.hpp"
 #include "generators.hpp"
 #include "radix_sort.hpp"
 
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <ctime>
+#endif
+
 using namespace std;
 
 namespace benchmark
@@ -27,7 +36,9 @@ namespace benchmark
 		STABLE_SORT,
 		STABLE_SORT_PAR,
 		RADIX_SORT,
-		RADIX_SORT_PAR
+		RADIX_SORT_PAR,
+		RADIX_SORT_NUMA,
+		RADIX_SORT_INPL
 	};
 
 	enum Type
@@ -55,6 +66,8 @@ namespace benchmark
 		"sort           ", "sort_par       ", 
 		"stable_sort    ", "stable_sort_par", 
 		"radix_sort     ", "radix_sort_par ",
+		"radix_sort_numa",
+		"radix_sort_inpl",
 	};
 	const vector<string> shape2str = {
 		"randomized", "sorted", "reverse sorted", "nearly sorted", "duplicates"
@@ -64,27 +77,55 @@ namespace benchmark
 		"COMPLEX_INT", "COMPLEX_LL", "COMPLEX_FLOAT", "COMPLEX_DOUBLE", "COMPLEX_STR",
 	};
 
+	// CPU time consumed by all threads of the process, in microseconds
+	long long getProcessCpuTime()
+	{
+#ifdef _WIN32
+		FILETIME creationTime, exitTime, kernelTime, userTime;
+		GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime);
+
+		auto toUs = [](const FILETIME& ft) {
+			return ((static_cast<long long>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime) / 10;
+		};
+		return toUs(kernelTime) + toUs(userTime);
+#else
+		timespec ts;
+		clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+		return static_cast<long long>(ts.tv_sec) * 1'000'000 + ts.tv_nsec / 1'000;
+#endif
+	}
+
 	struct Timer
 	{
 		chrono::steady_clock::time_point start_point;
 		chrono::steady_clock::time_point end_point;
+		long long cpu_start_point;
+		long long cpu_time;
 
 		Timer()
 		{
 			start_point = chrono::steady_clock::now();
 			end_point = start_point;
+			cpu_start_point = getProcessCpuTime();
+			cpu_time = 0;
 		};
 
 		void start()
 		{
 			start_point = chrono::steady_clock::now();
+			cpu_start_point = getProcessCpuTime();
 		}
 
 		long long stop()
 		{
 			end_point = chrono::steady_clock::now();
+			long long cpu_end_point = getProcessCpuTime();
+
 			auto time = chrono::duration_cast<chrono::microseconds>(end_point - start_point).count();
+			cpu_time = cpu_end_point - cpu_start_point;
+
 			start_point = end_point;
+			cpu_start_point = cpu_end_point;
 			return time;
 		}
 	};
@@ -152,11 +193,18 @@ namespace benchmark
 
 		Timer timer;
 		long long timeTotal = 0;
+		long long cpuTimeTotal = 0;
+
+		radix_sort::options inPlaceOptions;
+		inPlaceOptions.strategy = radix_sort::strategy::IN_PLACE;
 
 		for (int i = 0; i < iterations; i++)
 		{
 			vector<T> vSort(v);
 
+			if (method == RADIX_SORT_NUMA)
+				radix_sort::set_numa_awareness(true);
+
 			timer.start();
 			switch (method)
 			{
@@ -176,13 +224,21 @@ namespace benchmark
 					radix_sort::sort(vSort, LAMBDA_RDX, false);
 					break;
 				case RADIX_SORT_PAR:
+				case RADIX_SORT_NUMA:
 					radix_sort::sort(vSort, LAMBDA_RDX, true);
 					break;
+				case RADIX_SORT_INPL:
+					radix_sort::sort(vSort, LAMBDA_RDX, inPlaceOptions);
+					break;
 			}
 			timeTotal += timer.stop();
+			cpuTimeTotal += timer.cpu_time;
+
+			if (method == RADIX_SORT_NUMA)
+				radix_sort::set_numa_awareness(false);
 		}
 
-		output += format(lnum, "{} = {:L} us\n", method2str[method], timeTotal/iterations);
+		output += format(lnum, "{} = {:L} us (cpu = {:L} us)\n", method2str[method], timeTotal/iterations, cpuTimeTotal/iterations);
 	}
 
 	template <typename T, typename U = T>
@@ -190,7 +246,7 @@ namespace benchmark
 	{
 		vector<T> v(generators::generate<T>(n, static_cast<generators::Shape>(shape)));
 
-		for (int i = Method::SORT; i <= Method::RADIX_SORT_PAR; i++)
+		for (int i = Method::SORT; i <= Method::RADIX_SORT_INPL; i++)
 		{
 			if (METHODS[i])
 				benchmark<T, U>(v, iterations, static_cast<Method>(i), output);
@@ -203,7 +259,8 @@ namespace benchmark
 		{
 			params.SORT, params.SORT_PAR,
 			params.STABLE_SORT, params.STABLE_SORT_PAR,
-			params.RADIX_SORT, params.RADIX_SORT_PAR
+			params.RADIX_SORT, params.RADIX_SORT_PAR,
+			params.RADIX_SORT_NUMA, params.RADIX_SORT_INPL
 		};
 
 		const vector<int> SHAPES =
@@ -575,4 +632,149 @@ namespace benchmark
 
 		file.close();
 	}
+
+	template <typename T>
+	void scaling(size_t n, const vector<size_t>& threads, int iterations, string& output)
+	{
+		vector<T> v(generators::generate<T>(n, generators::Shape::RANDOMIZED));
+
+		for (const size_t& numOfThreads : threads)
+		{
+			radix_sort::set_max_threads(numOfThreads);
+
+			Timer timer;
+			long long timeTotal = 0;
+			long long cpuTimeTotal = 0;
+
+			for (int i = 0; i < iterations; i++)
+			{
+				vector<T> vSort(v);
+
+				timer.start();
+				radix_sort::sort(vSort, {}, true);
+				timeTotal += timer.stop();
+				cpuTimeTotal += timer.cpu_time;
+			}
+
+			long long time = timeTotal / iterations;
+			double throughput = (time) ? static_cast<double>(n) / time : 0.0;
+			output += format(lnum, "threads = {:>3} : {:L} us (cpu = {:L} us), {:.1f} M elements/s\n",
+				numOfThreads, time, cpuTimeTotal / iterations, throughput);
+		}
+
+		radix_sort::set_max_threads(thread::hardware_concurrency());
+	}
+
+	void scaling(ScalingParams params)
+	{
+		vector<size_t> threads = params.THREADS;
+		const size_t MAX_THREADS = max<size_t>(thread::hardware_concurrency(), 1);
+
+		if (threads.empty())
+		{
+			for (size_t numOfThreads : { 1, 2, 4, 8, 12, 16, 24, 32, 48, 64, 96, 128, 192, 256 })
+			{
+				if (numOfThreads < MAX_THREADS)
+					threads.emplace_back(numOfThreads);
+			}
+			threads.emplace_back(MAX_THREADS);
+		}
+
+		int iterations = params.ITERATIONS;
+
+		string curDateTime = format(
+			"{:%Y-%m-%d %H-%M-%S}",
+			chrono::zoned_time{ chrono::current_zone(), floor<chrono::seconds>(chrono::system_clock::now()) }
+		);
+		ofstream file;
+		filesystem::create_directory("benchmarks");
+		file.open(format("benchmarks//{} scaling.txt", curDateTime));
+
+		string output = "";
+		output += "===============================\n";
+		output += "--------SCALING STARTED--------\n";
+		output += "===============================\n\n";
+
+		cout << output;
+		file << output;
+
+		output.clear();
+		output += "===============================\n\n";
+
+		const vector<pair<int, Type>> TYPES =
+		{
+			{ params.INT, Type::INT },
+			{ params.ULL, Type::ULL },
+			{ params.DOUBLE, Type::DOUBLE },
+		};
+
+		for (const auto& [enabled, type] : TYPES)
+		{
+			if (!enabled)
+				continue;
+
+			for (const size_t& n : params.RUN_SIZE)
+			{
+				output += std::format(lnum, "{}\nSIZE = {:L} (randomized)\n\n", type2str[type], n);
+				switch (type)
+				{
+					case Type::INT:
+						scaling<int>(n, threads, iterations, output);
+						break;
+					case Type::ULL:
+						scaling<unsigned long long>(n, threads, iterations, output);
+						break;
+					case Type::DOUBLE:
+						scaling<double>(n, threads, iterations, output);
+						break;
+					default:
+						break;
+				}
+				output += "\n===============================\n\n";
+				cout << output;
+				file << output;
+				output.clear();
+			}
+		}
+
+		output += "===============================\n";
+		output += "--------SCALING STOPPED--------\n";
+		output += "===============================\n\n";
+
+		cout << output;
+		file << output;
+
+		file.close();
+	}
+
+	void calibration()
+	{
+		string output = "";
+		output += "===============================\n";
+		output += "------CALIBRATION STARTED------\n";
+		output += "===============================\n\n";
+
+		cout << output;
+		output.clear();
+
+		Timer timer;
+		timer.start();
+		bool saved = radix_sort::calibrate();
+		long long time = timer.stop();
+
+		if (saved)
+		{
+			ifstream file(radix_sort::internal::shared::PROFILE_PATH);
+			output += format(lnum, "{} ({:L} us)\n\n", radix_sort::internal::shared::PROFILE_PATH, time);
+			output += string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+		}
+		else
+			output += format("ERROR: Unable to save {}\n", radix_sort::internal::shared::PROFILE_PATH);
+
+		output += "\n===============================\n";
+		output += "------CALIBRATION STOPPED------\n";
+		output += "===============================\n\n";
+
+		cout << output;
+	}
 }
@@ -11,6 +11,8 @@ namespace benchmark
 		const int STABLE_SORT_PAR = 0;
 		const int RADIX_SORT      = 0;
 		const int RADIX_SORT_PAR  = 0;
+		const int RADIX_SORT_NUMA = 0;
+		const int RADIX_SORT_INPL = 0;
 	};
 
 	struct Sizes
@@ -28,6 +30,8 @@ namespace benchmark
 		const int STABLE_SORT_PAR = 0;
 		const int RADIX_SORT      = 0;
 		const int RADIX_SORT_PAR  = 0;
+		const int RADIX_SORT_NUMA = 0;
+		const int RADIX_SORT_INPL = 0;
 
 		const int RANDOMIZED     = 0;
 		const int SORTED         = 0;
@@ -59,6 +63,20 @@ namespace benchmark
 		const int ITERATIONS = 1;
 	};
 
+	struct ScalingParams
+	{
+		std::vector<size_t> RUN_SIZE = { static_cast<size_t>(1e8), static_cast<size_t>(1e9) };
+		std::vector<size_t> THREADS  = {}; // empty = 1, 2, 4, 8, 12, 16, 24, 32, ... up to hardware concurrency
+
+		const int INT    = 0;
+		const int ULL    = 0;
+		const int DOUBLE = 0;
+
+		const int ITERATIONS = 1;
+	};
+
 	void benchmark(RunParams params);
 	void testing(RunParams param);
+	void scaling(ScalingParams params);
+	void calibration();
 }
\ No newline at end of file
@@ -0,0 +1,203 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "generators.hpp"
+#include "radix_sort.hpp"
+
+namespace radix_sort
+{
+	namespace internal
+	{
+		namespace calibration
+		{
+			using namespace shared;
+
+			// =======================================
+			// -----Constants & Type Declarations-----
+			// =======================================
+
+			inline constexpr Index CALIBRATION_ITERATIONS = 3;
+			inline constexpr Index INSERTION_SORT_ELEMENTS = 1 << 16;
+			inline constexpr Index GLOBAL_BUCKET_ELEMENTS = 1 << 21;
+
+			inline constexpr std::array<generators::Shape, 3> SHAPES = {
+				generators::Shape::RANDOMIZED, generators::Shape::NEARLY_SORTED, generators::Shape::DUPLICATES
+			};
+
+			inline constexpr std::array<Index, 12> INSERTION_SORT_CANDIDATES = { 8, 16, 24, 32, 48, 64, 96, 128, 192, 256, 384, 512 };
+			inline constexpr std::array<Index, 8> MULTI_THREADING_CANDIDATES = { 1 << 15, 1 << 16, 1 << 17, 1 << 18, 1 << 19, 1 << 20, 1 << 21, 1 << 22 };
+			inline constexpr std::array<Index, 7> GLOBAL_BUCKET_CANDIDATES = { 1'000, 2'500, 5'000, 10'000, 25'000, 50'000, 100'000 };
+
+			// =================
+			// -----Helpers-----
+			// =================
+
+			// numOfInputs slices of size n per shape, cut from one generated vector so every slice holds different data
+			template <typename T>
+			inline std::vector<std::vector<T>> generateInputs(Index n, Index numOfInputs)
+			{
+				std::vector<std::vector<T>> inputs;
+				inputs.reserve(SHAPES.size() * numOfInputs);
+
+				for (const auto& shape : SHAPES)
+				{
+					std::vector<T> v = generators::internal::generate_impl<T>(n * numOfInputs, shape);
+
+					for (Index i = 0; i < numOfInputs; i++)
+						inputs.emplace_back(v.begin() + i * n, v.begin() + (i + 1) * n);
+				}
+
+				return inputs;
+			}
+
+			// best of CALIBRATION_ITERATIONS runs over all inputs, in nanoseconds (copies are made outside the timed region)
+			template <typename T>
+			inline long long measure(const std::vector<std::vector<T>>& inputs, const Options& options)
+			{
+				long long best = std::numeric_limits<long long>::max();
+
+				for (Index i = 0; i < CALIBRATION_ITERATIONS; i++)
+				{
+					std::vector<std::vector<T>> copies(inputs);
+
+					auto start = std::chrono::steady_clock::now();
+					for (auto& v : copies)
+						radix_sort::sort(v, std::identity{}, options);
+					auto end = std::chrono::steady_clock::now();
+
+					best = std::min<long long>(best, std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+				}
+
+				return best;
+			}
+
+			// =========================
+			// -----Implementations-----
+			// =========================
+
+			// largest size at which insertion sort still beats a radix pass
+			template <typename T>
+			inline Index calibrateInsertionSort()
+			{
+				Index threshold = INSERTION_SORT_CANDIDATES.front();
+
+				for (const auto& n : INSERTION_SORT_CANDIDATES)
+				{
+					std::vector<std::vector<T>> inputs = generateInputs<T>(n, INSERTION_SORT_ELEMENTS / n);
+
+					Options insertion;
+					insertion.insertionSortThresholdAll = n;
+
+					Options radix;
+					radix.insertionSortThresholdAll = 0;
+
+					if (measure(inputs, insertion) > measure(inputs, radix))
+						break;
+
+					threshold = n;
+				}
+
+				return threshold;
+			}
+
+			// smallest size from which two threads beat one, the way the profile would split it (minElementsPerThread = threshold / 2)
+			template <typename T>
+			inline Index calibrateMultiThreading()
+			{
+				if (MAX_HW_THREADS < 2)
+					return MULTI_THREADING_THRESHOLD;
+
+				constexpr Index NUM_OF_CANDIDATES = MULTI_THREADING_CANDIDATES.size();
+				std::array<bool, NUM_OF_CANDIDATES> wins = {};
+
+				for (Index i = 0; i < NUM_OF_CANDIDATES; i++)
+				{
+					Index n = MULTI_THREADING_CANDIDATES[i];
+					std::vector<std::vector<T>> inputs = generateInputs<T>(n, 1);
+
+					Options serial;
+
+					Options parallel;
+					parallel.enableMultiThreading = true;
+					parallel.multiThreadingThreshold = n;
+					parallel.minElementsPerThread = n >> 1;
+					parallel.parallelScatterThreshold = n << 1;
+
+					wins[i] = measure(inputs, parallel) < measure(inputs, serial);
+				}
+
+				// a single win followed by a loss is noise, the crossover has to hold for the next size too
+				for (Index i = 0; i < NUM_OF_CANDIDATES; i++)
+				{
+					if (wins[i] && (i == NUM_OF_CANDIDATES - 1 || wins[i + 1]))
+						return MULTI_THREADING_CANDIDATES[i];
+				}
+
+				return MULTI_THREADING_CANDIDATES.back() << 1;
+			}
+
+			// bucket size above which parallel MSD publishes a bucket for stealing instead of keeping it local
+			template <typename T>
+			inline Index calibrateGlobalBucket()
+			{
+				// single byte keys are always sorted with LSD, which never publishes buckets
+				if (MAX_HW_THREADS < 2 || sizeof(T) <= SMALL_INTEGRAL_THRESHOLD_BYTES)
+					return GLOBAL_BUCKET_THRESHOLD;
+
+				std::vector<std::vector<T>> inputs = generateInputs<T>(GLOBAL_BUCKET_ELEMENTS, 1);
+				Index threshold = GLOBAL_BUCKET_THRESHOLD;
+				long long best = std::numeric_limits<long long>::max();
+
+				for (const auto& candidate : GLOBAL_BUCKET_CANDIDATES)
+				{
+					Options parallel;
+					parallel.enableMultiThreading = true;
+					parallel.globalBucketThreshold = candidate;
+
+					long long time = measure(inputs, parallel);
+					if (time < best)
+					{
+						best = time;
+						threshold = candidate;
+					}
+				}
+
+				return threshold;
+			}
+
+			template <typename T>
+			inline void calibrateWidth()
+			{
+				ProfileEntry entry;
+				entry.insertionSortThresholdAll = calibrateInsertionSort<T>();
+				entry.multiThreadingThreshold = calibrateMultiThreading<T>();
+				entry.globalBucketThreshold = calibrateGlobalBucket<T>();
+
+				Profile::instance().set(sizeof(T), entry);
+			}
+		}
+	}
+
+	// =============
+	// -----API-----
+	// =============
+
+	// Measures the insertion sort, multi-threading and global bucket crossovers for 1, 2, 4 and 8 byte keys with short micro-sorts,
+	// applies them to the running process and saves them to path, which radix_sort::sort loads on first use. Takes up to half a minute.
+	inline bool calibrate(const std::string& path = internal::shared::PROFILE_PATH)
+	{
+		internal::calibration::calibrateWidth<char>();
+		internal::calibration::calibrateWidth<short>();
+		internal::calibration::calibrateWidth<int>();
+		internal::calibration::calibrateWidth<long long>();
+
+		return internal::shared::Profile::instance().save(path);
+	}
+};
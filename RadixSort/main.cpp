@@ -2,6 +2,7 @@
 
 int main()
 {
+	//benchmark::calibration();
 	//benchmark::testing
 	benchmark::benchmark
 	({
@@ -11,6 +12,8 @@ int main()
 		.STABLE_SORT_PAR = 1,
 		.RADIX_SORT      = 1,
 		.RADIX_SORT_PAR  = 1,
+		.RADIX_SORT_NUMA = 1,
+		.RADIX_SORT_INPL = 1,
 		.RANDOMIZED     = 1,
 		.SORTED         = 1,
 		.REVERSE_SORTED = 1,
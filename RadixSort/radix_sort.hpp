@@ -1,16 +1,61 @@
 #pragma once
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define RADIX_SORT_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#endif
+
+// GCC and Clang only emit AVX instructions in functions marked for them, MSVC compiles the intrinsics anywhere
+#if defined(RADIX_SORT_X86) && (defined(__GNUC__) || defined(__clang__))
+#define RADIX_SORT_TARGET(isa) __attribute__((target(isa)))
+#else
+#define RADIX_SORT_TARGET(isa)
+#endif
+
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
 #include <compare>
 #include <concepts>
+#include <condition_variable>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
 #include <execution>
+#include <fstream>
+#include <functional>
+#include <latch>
 #include <limits>
+#include <memory>
 #include <mutex>
+#include <new>
 #include <numeric>
 #include <span>
+#include <sstream>
 #include <string>
 #include <thread>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace radix_sort
@@ -28,12 +73,25 @@ namespace radix_sort
 			// =======================================
 			
 			using Index = std::size_t; // int or std::size_t
+			using SmallIndex = std::uint32_t; // indices and counters of inputs below SMALL_INDEX_LIMIT items, half the bytes to move
 
 			inline constexpr Index SHIFT_BITS = 8;
 			inline constexpr Index BASE = 256;
 			inline constexpr Index MASK = 0xFF;
 			inline constexpr Index INVERT_MASK = 0x80;
 
+			// LSD digits can be wider than a byte: fewer passes for larger histograms
+			inline constexpr Index WIDE_DIGIT_BITS = 11;
+			inline constexpr Index MAX_DIGIT_BITS = 16;
+			inline constexpr Index WIDE_DIGIT_THRESHOLD_BYTES = 1 << 24; // directly scattered LSD inputs from this size take WIDE_DIGIT_BITS digits when that saves a pass
+			inline constexpr Index MAX_DIGIT_THRESHOLD_BYTES = 1 << 26; // and MAX_DIGIT_BITS digits from this size
+
+			template <Index BITS>
+			inline constexpr Index DIGIT_BASE = static_cast<Index>(1) << BITS;
+
+			template <Index BITS>
+			inline constexpr Index DIGIT_MASK = DIGIT_BASE<BITS> - 1;
+
 			inline constexpr Index CHARS = 256;
 			inline constexpr Index CHARS_ALLOC = 257;
 
@@ -41,13 +99,103 @@ namespace radix_sort
 			inline constexpr Index LARGE_INTEGRAL_THRESHOLD_BYTES = 8;
 			inline constexpr Index INSERTION_SORT_THRESHOLD_STR = 10;
 			inline constexpr Index INSERTION_SORT_THRESHOLD_ALL = 100;
+			inline constexpr Index SORTING_NETWORK_MAX = 32; // largest bucket of keys sorted by a branch-free sorting network
+			inline constexpr Index SORTING_NETWORK_PAIRS_MAX = 16; // and of (key, index) pairs, their compare-exchange costs twice as much
+			inline constexpr Index SMALL_SORT_SIMD_MIN = 16; // smallest bucket sorted in AVX-512 registers, below it the padding costs more than a network
+			inline constexpr Index SMALL_SORT_SIMD_MAX = 256; // largest bucket sorted in AVX-512 registers
 			inline constexpr Index STRING_MSD_MAX_DEPTH = 3;
 
-			inline const Index MAX_HW_THREADS = std::thread::hardware_concurrency();
+			enum class ThreadScaling { POWER_OF_TWO, LINEAR };
+
+			inline const Index MAX_HW_THREADS = std::max<Index>(std::thread::hardware_concurrency(), 1);
 			inline constexpr Index MAX_SW_THREADS = 12;
+			inline constexpr ThreadScaling THREAD_SCALING = ThreadScaling::LINEAR;
 			inline constexpr Index MULTI_THREADING_THRESHOLD = 1'000'000;
-			inline constexpr Index SLEEP_ITERATIONS_THRESHOLD = 100;
+			inline constexpr Index MIN_ELEMENTS_PER_THREAD = 500'000;
+			inline constexpr Index HIERARCHICAL_MERGE_THRESHOLD = 16;
+			inline constexpr Index SPIN_ITERATIONS_THRESHOLD = 100;
 			inline constexpr Index GLOBAL_BUCKET_THRESHOLD = 10'000;
+			inline constexpr Index PARALLEL_SCATTER_THRESHOLD = MULTI_THREADING_THRESHOLD << 1;
+			inline constexpr Index HUGE_PAGE_SIZE = 1 << 21;
+			inline constexpr Index HUGE_PAGE_THRESHOLD_BYTES = 1 << 25;
+
+			inline constexpr Index SMALL_INDEX_LIMIT = std::numeric_limits<SmallIndex>::max();
+			inline constexpr Index SUB_HISTOGRAMS = 4;
+			inline constexpr Index SUB_HISTOGRAM_THRESHOLD = 1 << 12; // below it zeroing and merging the extra histograms costs more than it saves
+			inline constexpr Index MAX_LENGTH_BLOCK = 1 << 14; // keys OR-ed by getMaxLength between checks for a full length key
+
+			inline constexpr Index CACHE_LINE_BYTES = 64;
+			inline constexpr Index STREAMING_SCATTER_THRESHOLD_BYTES = 1 << 24; // LSD destinations from this size are scattered with non-temporal stores
+			inline constexpr Index IN_PLACE_BLOCK_BYTES = 1 << 11; // unit the parallel in-place engine classifies into and permutes
+			inline constexpr Index MSD_COPY_BACK_THRESHOLD_BYTES = 1 << 16; // MSD regions below it are copied back whole after their pass instead of alternating arrays
+			inline constexpr Index MSD_LSD_THRESHOLD_BYTES = 1 << 18; // MSD regions up to it (about an L2) are finished by an LSD over their remaining bytes
+
+			inline constexpr Index SAMPLING_THRESHOLD = 1 << 12;
+			inline constexpr Index SAMPLE_SIZE = 1 << 10;
+			inline constexpr Index COUNTING_SORT_BITS = 16;
+			inline constexpr Index COUNTING_SORT_MAX_RANGE = 1 << COUNTING_SORT_BITS;
+			inline constexpr Index COUNTING_FILL_RUN = 8; // counting sort of values writes this many copies per key without branching when the average run is shorter
+			inline constexpr double PRESORTED_THRESHOLD = 0.99;
+			inline constexpr double PRESORTED_MSD_THRESHOLD = 0.9;
+			inline constexpr double MSD_PASS_COST = 2.0; // an MSD level counts and scatters region by region (small ones are copied back) and leaves insertion sorts behind, an LSD pass streams the whole array
+
+			inline constexpr Index PROFILE_WIDTHS = 4; // 1, 2, 4 and 8 byte keys
+			inline constexpr const char* PROFILE_PATH = "radix_sort.profile";
+
+			// process-wide cap on the threads a sort may use (the caller included), see radix_sort::set_max_threads
+			inline std::atomic<Index> maxConcurrency = MAX_HW_THREADS;
+
+			// pinned workers, first-touch scratch placement and huge pages, see radix_sort::set_numa_awareness
+			inline std::atomic<bool> numaAwareness = false;
+
+			enum class Strategy { AUTO, LSD, MSD, COUNTING, COMPARISON, IN_PLACE };
+
+			// How a radix pass writes its buckets: straight to the destination, through cache line sized buffers per bucket,
+			// or through those buffers with non-temporal stores. AUTO streams large LSD passes and scatters the rest directly.
+			enum class Scatter { AUTO, DIRECT, BUFFERED, STREAMING };
+
+			// What selectStrategy saw in its sample and which engine it picked, see Options::report.
+			// strategy stays AUTO when no engine ran (already sorted or small enough for insertion sort).
+			struct Report
+			{
+				Strategy strategy = Strategy::AUTO;
+				std::string reason;
+				Index sampleSize = 0;
+				Index distinctKeys = 0; // within the sample
+				double presortedness = 0.0; // fraction of sampled neighbours in order
+				std::array<double, 8> entropy = {}; // bits per key byte, least significant first
+				std::uint64_t minKey = 0; // exact key range (sign adjusted), only filled when counting sort was considered
+				Index keyRange = 0;
+				Index keyLength = 0; // significant key bytes (characters for strings) the choice was made for
+				Index numOfThreads = 1;
+			};
+
+			struct Plan;
+			class ScratchArena;
+
+			// Per-call tuning knobs, see radix_sort::options. The defaults are the compile-time constants above.
+			struct Options
+			{
+				bool enableMultiThreading = false;
+				Index numOfThreads = 0; // 0 = derived from the input size
+				ThreadScaling threadScaling = THREAD_SCALING;
+				Index maxSwThreads = MAX_SW_THREADS;
+				Index multiThreadingThreshold = MULTI_THREADING_THRESHOLD;
+				Index minElementsPerThread = MIN_ELEMENTS_PER_THREAD;
+				Index globalBucketThreshold = GLOBAL_BUCKET_THRESHOLD;
+				Index parallelScatterThreshold = PARALLEL_SCATTER_THRESHOLD;
+				Index insertionSortThresholdStr = INSERTION_SORT_THRESHOLD_STR;
+				Index insertionSortThresholdAll = INSERTION_SORT_THRESHOLD_ALL;
+				Index stringMsdMaxDepth = STRING_MSD_MAX_DEPTH;
+				Index msdLsdThresholdBytes = MSD_LSD_THRESHOLD_BYTES; // fixed-width MSD regions up to it finish with an in-cache LSD (0 = never)
+				Strategy strategy = Strategy::AUTO;
+				Scatter scatter = Scatter::AUTO;
+				Index digitBits = 0; // LSD digit width, 8, 11 or 16 (0 = picked from the key length, input size and scatter)
+				Index maxScratchBytes = std::numeric_limits<Index>::max(); // above it fixed-width keys are radix sorted in place, strings with a comparison sort
+				Report* report = nullptr; // receives the chosen path and its reason
+				Plan* plan = nullptr; // set by radix_sort::plan, replays its last decision and lends its scratch
+				ScratchArena* workspace = nullptr; // scratch kept across calls, see radix_sort::workspace (a plan's own scratch wins)
+			};
 
 			struct Region
 			{
@@ -55,7 +203,9 @@ namespace radix_sort
 				Index r;
 				Index len;
 				Index curShiftOrIndex;
-				Region(Index l, Index r, Index len, Index curShiftOrIndex) : l(l), r(r), len(len), curShiftOrIndex(curShiftOrIndex) {}
+				bool inTmp; // MSD levels alternate between v and tmp, set when the region's items are in tmp
+				Region() : l(0), r(0), len(0), curShiftOrIndex(0), inTmp(false) {}
+				Region(Index l, Index r, Index len, Index curShiftOrIndex, bool inTmp = false) : l(l), r(r), len(len), curShiftOrIndex(curShiftOrIndex), inTmp(inTmp) {}
 			};
 
 			// ====================================
@@ -74,6 +224,14 @@ namespace radix_sort
 			template <typename T>
 			concept is_string = std::same_as<T, std::string>;
 
+			// items a scatter can gather into whole cache lines before writing them out
+			template <typename T>
+			concept is_line_scatterable = std::is_trivially_copyable_v<T> && CACHE_LINE_BYTES % sizeof(T) == 0;
+
+			// items the parallel in-place engine can hold in its block buffers and move around block-wise
+			template <typename T>
+			concept is_block_movable = std::is_trivially_copyable_v<T> && std::default_initializable<T>;
+
 			template <typename T>
 			concept supported = std::integral<T> || is_floating_point<T> || is_string<T>;
 
@@ -100,401 +258,3145 @@ namespace radix_sort
 			template <typename T>
 			using t2u = t2u_impl<sizeof(T)>::type;
 
-			// =================
-			// -----Helpers-----
-			// =================
+			// unsigned type an integral key array may be read through by the raw kernels (its own unsigned variant, bool through unsigned char)
+			template <typename T>
+			using alias_unsigned = std::conditional_t<std::same_as<T, bool>, std::type_identity<unsigned char>, std::make_unsigned<T>>::type;
 
-			inline Index getChar(const std::string& s, Index index)
-			{
-				return (index < s.length()) ? static_cast<unsigned char>(s[index]) : 256;
-			}
+			// =====================
+			// -----Thread Pool-----
+			// =====================
 
-			inline Index getNumOfThreads(Index n)
+			// Pins a thread to the cpuIndex-th cpu the process may run on, or lets it run anywhere again.
+			inline void setThreadAffinity(std::thread& thread, Index cpuIndex, bool pin)
 			{
-				if (n < (MULTI_THREADING_THRESHOLD << 1))
-					return 1;
+#ifdef _WIN32
+				const Index NUM_OF_CPUS = std::min<Index>(MAX_HW_THREADS, 64);
+				DWORD_PTR mask = (pin) ? (static_cast<DWORD_PTR>(1) << (cpuIndex % NUM_OF_CPUS)) : ~static_cast<DWORD_PTR>(0);
+				SetThreadAffinityMask(thread.native_handle(), mask);
+#else
+				cpu_set_t allowed;
+				CPU_ZERO(&allowed);
+				if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+					return;
 
-				Index ratio = n / MULTI_THREADING_THRESHOLD;
-				Index numOfThreads = 1;
-				while ((numOfThreads << 1) <= ratio) 
-					numOfThreads <<= 1;
+				cpu_set_t set;
+				CPU_ZERO(&set);
+
+				if (!pin)
+					set = allowed;
+				else
+				{
+					Index numOfAllowed = CPU_COUNT(&allowed);
+					Index target = cpuIndex % std::max<Index>(numOfAllowed, 1);
 
-				return std::min({ numOfThreads, MAX_HW_THREADS, MAX_SW_THREADS });
+					for (Index cpu = 0; cpu < CPU_SETSIZE; cpu++)
+					{
+						if (CPU_ISSET(cpu, &allowed) && target-- == 0)
+						{
+							CPU_SET(cpu, &set);
+							break;
+						}
+					}
+				}
+
+				pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#endif
 			}
 
-			template <typename T>
-			inline void getCountVectorThread(std::vector<T>& v, std::vector<Index>& count, Index curShiftOrIndex, Index l, Index r)
+			// Process-wide pool shared by every parallel phase.
+			// Workers are handed out from a global budget, so a parallel region nested inside another one
+			// (e.g. getCountVector called from an MSD worker) runs inline instead of oversubscribing the cores.
+			class ThreadPool
 			{
-				if constexpr (is_string<T>)
+			public:
+				static ThreadPool& instance()
 				{
-					for (const auto& str : std::span(v).subspan(l, r - l))
-						count[getChar(str, curShiftOrIndex)]++;
+					static ThreadPool pool(MAX_HW_THREADS - 1);
+					return pool;
 				}
-				else if constexpr (std::unsigned_integral<T>)
+
+				ThreadPool(const ThreadPool&) = delete;
+				ThreadPool& operator=(const ThreadPool&) = delete;
+
+				// worker i is pinned to cpu i + 1, the caller (thread 0 of every team) is left alone
+				void setAffinity(bool pin)
 				{
-					for (const auto& num : std::span(v).subspan(l, r - l))
-						count[(num >> curShiftOrIndex) & MASK]++;
+					for (Index i = 0, size = workers.size(); i < size; i++)
+						setThreadAffinity(workers[i], i + 1, pin);
 				}
-				else if constexpr (std::signed_integral<T>)
-				{
-					constexpr Index MAX_SHIFT = (sizeof(T) - 1) * 8;
 
-					if (curShiftOrIndex != MAX_SHIFT)
-					{
-						for (const auto& num : std::span(v).subspan(l, r - l))
-							count[(static_cast<t2u<T>>(num) >> curShiftOrIndex) & MASK]++;
-					}
-					else
+				~ThreadPool()
+				{
 					{
-						for (const auto& num : std::span(v).subspan(l, r - l))
-							count[((static_cast<t2u<T>>(num) >> curShiftOrIndex) & MASK) ^ INVERT_MASK]++;
+						std::lock_guard<std::mutex> lk(jobsLock);
+						stopping = true;
 					}
-				}
-			}
-
-			template <typename T>
-			inline void getCountVector(std::vector<T>& v, std::vector<Index>& count, Index curShiftOrIndex, Index l, Index r, bool enableMultiThreading)
-			{
-				const Index SIZE = r - l;
-				Index numOfThreads = getNumOfThreads(SIZE);
+					jobsCv.notify_all();
 
-				if (!enableMultiThreading || numOfThreads <= 1)
-				{
-					getCountVectorThread(v, count, curShiftOrIndex, l, r);
+					for (auto& t : workers)
+						t.join();
 				}
-				else
+
+				// Runs func(threadIndex, numOfThreads) concurrently on up to numOfThreads threads, the caller being thread 0.
+				// The team may be smaller than requested when the budget is exhausted, func must handle any team size.
+				template <typename Func>
+				void run(Index numOfThreads, Func&& func)
 				{
-					constexpr Index ALLOC_SIZE = (is_string<T>) ? CHARS_ALLOC : BASE;
-					std::vector<std::vector<Index>> counts(numOfThreads, std::vector<Index>(ALLOC_SIZE));
-					
-					std::vector<std::thread> threads;
-					Index bucketSize = SIZE / numOfThreads;
+					Index helpers = (numOfThreads > 1) ? acquire(numOfThreads - 1) : 0;
 
-					for (Index i = 0; i < numOfThreads; i++)
+					if (helpers == 0)
 					{
-						Index start = l + i * bucketSize;
-						Index end = (i == numOfThreads - 1) ? r : start + bucketSize;
-						threads.emplace_back([&v, &counts, i, curShiftOrIndex, start, end]() {
-							getCountVectorThread(v, counts[i], curShiftOrIndex, start, end);
-						});
+						func(static_cast<Index>(0), static_cast<Index>(1));
+						return;
 					}
 
-					for (auto& t : threads)
-						t.join();
+					const Index TEAM_SIZE = helpers + 1;
+					std::latch done(static_cast<std::ptrdiff_t>(helpers));
 
-					for (Index curThread = 0; curThread < numOfThreads; curThread++)
+					for (Index i = 1; i < TEAM_SIZE; i++)
 					{
-						for (Index i = 0; i < ALLOC_SIZE; i++)
-							count[i] += counts[curThread][i];
+						submit([&func, &done, i, TEAM_SIZE]() {
+							func(i, TEAM_SIZE);
+							done.count_down();
+						});
 					}
+
+					func(static_cast<Index>(0), TEAM_SIZE);
+					done.wait();
+
+					release(helpers);
 				}
-			}
 
-			template <typename T>
-			inline void getPrefixVector(std::vector<Index>& prefix, std::vector<Index>& count, Index l)
-			{
-				if constexpr (is_string<T>)
+			private:
+				std::vector<std::thread> workers;
+				std::deque<std::function<void()>> jobs;
+				std::mutex jobsLock;
+				std::condition_variable jobsCv;
+				std::atomic<Index> inUse;
+				bool stopping = false;
+
+				explicit ThreadPool(Index numOfWorkers) : inUse(0)
 				{
-					prefix[256] = l;
-					prefix[0] = prefix[256] + count[256];
+					workers.reserve(numOfWorkers);
+					for (Index i = 0; i < numOfWorkers; i++)
+						workers.emplace_back([this]() { workerLoop(); });
+
+					if (numaAwareness.load(std::memory_order_relaxed))
+						setAffinity(true);
 				}
-				else
+
+				Index acquire(Index requested)
 				{
-					prefix[0] = l;
-				}
+					const Index LIMIT = std::min<Index>(workers.size(), maxConcurrency.load(std::memory_order_relaxed) - 1);
+					Index cur = inUse.load(std::memory_order_relaxed);
+					Index granted = 0;
 
-				for (Index i = 1; i < BASE; i++)
-					prefix[i] = prefix[i - 1] + count[i - 1];
-			}
+					do
+					{
+						granted = (cur < LIMIT) ? std::min(requested, LIMIT - cur) : 0;
+						if (granted == 0)
+							return 0;
+					} while (!inUse.compare_exchange_weak(cur, cur + granted, std::memory_order_acquire, std::memory_order_relaxed));
 
-			template <typename T>
-			inline void partitionRegions(std::vector<Index>& count, std::vector<Region>& regionsLocal,
-				std::vector<Region>& regions, std::unique_lock<std::mutex>& lkRegions,
-				Index len, Index curShiftOrIndex, Index l, bool enableMultiThreading)
-			{
-				Index start = 0;
-				if constexpr (is_string<T>)
-				{
-					start = l + count[256];
-					curShiftOrIndex++;
+					return granted;
 				}
-				else
+
+				void release(Index count)
 				{
-					start = l;
-					curShiftOrIndex -= SHIFT_BITS;
+					inUse.fetch_sub(count, std::memory_order_release);
 				}
 
-				if (!enableMultiThreading)
+				void submit(std::function<void()> job)
 				{
-					for (Index i = 0; i < BASE; i++)
 					{
-						if (count[i] > 1)
-							regionsLocal.emplace_back(start, start + count[i], len, curShiftOrIndex);
-						start += count[i];
+						std::lock_guard<std::mutex> lk(jobsLock);
+						jobs.emplace_back(std::move(job));
 					}
+					jobsCv.notify_one();
 				}
-				else
+
+				void workerLoop()
 				{
-					for (Index i = 0; i < BASE; i++)
+					std::unique_lock<std::mutex> lk(jobsLock);
+
+					while (true)
 					{
-						if (count[i] > 1)
-						{
-							if (count[i] < GLOBAL_BUCKET_THRESHOLD)
-								regionsLocal.emplace_back(start, start + count[i], len, curShiftOrIndex);
-							else
-							{
-								lkRegions.lock();
-								regions.emplace_back(start, start + count[i], len, curShiftOrIndex);
-								lkRegions.unlock();
-							}
-						}
-						start += count[i];
+						jobsCv.wait(lk, [this]() { return stopping || !jobs.empty(); });
+
+						if (jobs.empty())
+							return;
+
+						std::function<void()> job = std::move(jobs.front());
+						jobs.pop_front();
+
+						lk.unlock();
+						job();
+						lk.lock();
 					}
 				}
+			};
+
+			// Splits [0, numOfChunks) across the pool, chunks are distributed round-robin over the team that was granted.
+			template <typename Func>
+			inline void parallelFor(Index numOfChunks, Func&& func)
+			{
+				ThreadPool::instance().run(numOfChunks, [&func, numOfChunks](Index threadIndex, Index numOfThreads) {
+					for (Index i = threadIndex; i < numOfChunks; i += numOfThreads)
+						func(i);
+				});
 			}
-		}
 
-		// =======================
-		// -----T sorted by T-----
-		// =======================
+			// ================
+			// -----Memory-----
+			// ================
 
-		namespace value
-		{
-			using namespace shared;
-			
-			// =================
-			// -----Helpers-----
-			// =================
-			
-			template <typename T>
-			inline bool isSortedBi(std::vector<T>& v)
+			// Raw storage for scratch buffers. In NUMA-aware mode large buffers are mapped without being touched,
+			// so every page lands on the node of the thread that first writes it, and on Linux they are marked for transparent huge pages.
+			inline void* allocateScratch(Index bytes, Index alignment, bool& isMapped)
 			{
-				if (v.size() < 2)
-					return true;
+				isMapped = numaAwareness.load(std::memory_order_relaxed) && bytes >= HUGE_PAGE_THRESHOLD_BYTES;
 
-				constexpr auto cmpLess = (is_floating_point<T>) ?
-					[](const T& a, const T& b) { return std::strong_order(a, b) < 0; } :
-					[](const T& a, const T& b) { return a < b; };
+				if (!isMapped)
+					return ::operator new(std::max<Index>(bytes, 1), std::align_val_t(alignment));
 
-				constexpr auto cmpGreater = (is_floating_point<T>) ?
-					[](const T& a, const T& b) { return std::strong_order(a, b) > 0; } :
-					[](const T& a, const T& b) { return a > b; };
+#ifdef _WIN32
+				void* p = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+				Index mappedBytes = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+				void* p = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 
-				bool sortedAsc = true;
-				bool sortedDesc = true;
+				if (p == MAP_FAILED)
+					p = nullptr;
+				else
+					madvise(p, mappedBytes, MADV_HUGEPAGE);
+#endif
+				if (!p)
+					throw std::bad_alloc();
 
-				for (Index i = 0, size = v.size() - 1; i < size; i++)
-				{
-					if (sortedAsc && cmpGreater(v[i], v[i + 1]))
-						sortedAsc = false;
-					if (sortedDesc && cmpLess(v[i], v[i + 1]))
-						sortedDesc = false;
-					if (!sortedAsc && !sortedDesc)
-						break;
-				}
+				return p;
+			}
 
-				if (sortedAsc)
-					return true;
-				else if (sortedDesc)
+			inline void freeScratch(void* p, Index bytes, Index alignment, bool isMapped)
+			{
+				if (!isMapped)
 				{
-					std::reverse(v.begin(), v.end());
-					return true;
+					::operator delete(p, std::align_val_t(alignment));
+					return;
 				}
 
-				return false;
+#ifdef _WIN32
+				VirtualFree(p, 0, MEM_RELEASE);
+#else
+				munmap(p, (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE);
+#endif
 			}
 
-			template <typename T>
-			inline Index getMaxLength(std::vector<T>& v)
+			// Scratch blocks that outlive a sort, see radix_sort::plan and radix_sort::workspace. Buffers take the blocks in construction order
+			// (a sort holds only a few at once) and grow them on demand, so repeated sorts of one size class
+			// allocate and fault in their scratch only once. Not thread-safe, buffers are only created by the calling thread.
+			class ScratchArena
 			{
-				Index len = 0;
-				constexpr Index MAX_LEN = sizeof(T);
+			public:
+				ScratchArena() = default;
 
-				if constexpr (MAX_LEN == 1 || is_floating_point<T>)
-				{
-					return MAX_LEN;
-				}
-				if constexpr (std::signed_integral<T>)
-				{
-					T maxNum = std::numeric_limits<T>::min();
+				ScratchArena(const ScratchArena&) = delete;
+				ScratchArena& operator=(const ScratchArena&) = delete;
 
-					for (const auto& num : v)
+				~ScratchArena()
+				{
+					for (auto& block : blocks)
 					{
-						if (num < 0)
-							return MAX_LEN;
-						else if (num > maxNum)
-						{
-							maxNum = num;
-							while (len != MAX_LEN)
-							{
-								if (maxNum >> (SHIFT_BITS * len) == 0)
-									break;
-
-								len++;
-								if (len == MAX_LEN)
-									return MAX_LEN;
-							}
-						}
+						if (block.ptr)
+							freeScratch(block.ptr, block.bytes, block.alignment, block.isMapped);
 					}
 				}
-				else if constexpr (std::unsigned_integral<T>)
+
+				void* acquire(Index bytes, Index alignment, bool& isMapped)
 				{
-					T maxNum = std::numeric_limits<T>::min();
+					if (depth == blocks.size())
+						blocks.emplace_back();
 
-					for (const auto& num : v)
+					Block& block = blocks[depth];
+					if (block.bytes < bytes || block.alignment < alignment)
 					{
-						if (num > maxNum)
-						{
-							maxNum = num;
-							while (len != MAX_LEN)
-							{
-								if (maxNum >> (SHIFT_BITS * len) == 0)
-									break;
-								
-								len++;
-								if (len == MAX_LEN)
-									return MAX_LEN;
-							}
-						}
+						if (block.ptr)
+							freeScratch(block.ptr, block.bytes, block.alignment, block.isMapped);
+
+						block = Block();
+						block.ptr = allocateScratch(bytes, alignment, block.isMapped);
+						block.bytes = bytes;
+						block.alignment = alignment;
 					}
+
+					depth++;
+					isMapped = block.isMapped;
+					return block.ptr;
 				}
-				else if constexpr (is_string<T>)
+
+				void release()
 				{
-					len = (*std::max_element(v.begin(), v.end(),
-						[](const std::string& a, const std::string& b) {
-							return a.length() < b.length();
-						})).length();
+					depth--;
 				}
 
-				return len;
-			}
+				Index size() const
+				{
+					Index bytes = 0;
+					for (const auto& block : blocks)
+						bytes += block.bytes;
 
-			template <typename T>
-			inline void insertionSort(std::vector<T>& v, Index l, Index r)
-			{
-				constexpr auto cmp = (is_floating_point<T>) ?
-					[](const T& a, const T& b) { return std::strong_order(a, b) < 0; } :
-					[](const T& a, const T& b) { return a < b; };
+					return bytes;
+				}
 
-				for (Index i = l + 1; i < r; i++)
+				// frees every block, only between sorts
+				void clear()
 				{
-					T val = std::move(v[i]);
-					Index j = i;
-
-					while (j > l && cmp(val, v[j - 1]))
+					for (auto& block : blocks)
 					{
-						v[j] = std::move(v[j - 1]);
-						j--;
+						if (block.ptr)
+							freeScratch(block.ptr, block.bytes, block.alignment, block.isMapped);
 					}
 
-					v[j] = std::move(val);
+					blocks.clear();
 				}
-			}
 
-			template <typename T, typename U>
-			inline void getUnsignedVectorThread(std::vector<T>& v, std::vector<U>& vu, bool reverse, Index l, Index r)
-			{
-				constexpr Index SIGN_SHIFT = (sizeof(T) * 8) - 1;
-				constexpr U SIGN_MASK = 1LL << SIGN_SHIFT;
+			private:
+				struct Block
+				{
+					void* ptr = nullptr;
+					Index bytes = 0;
+					Index alignment = 0;
+					bool isMapped = false;
+				};
+
+				std::vector<Block> blocks;
+				Index depth = 0;
+			};
 
-				if (!reverse)
+			// Scratch array (the tmp / key / index buffers), borrowed from arena when one is given. Nothing is written up front,
+			// so every page is first touched by the thread that scatters into it: trivially copyable items live in the raw storage,
+			// other types are constructed by the first scatter into it (putItem, then setConstructed) or, where an engine cannot
+			// scatter into raw slots, by construct() in the same chunks the parallel passes use.
+			template <typename T>
+			class ScratchBuffer
+			{
+			public:
+				ScratchBuffer(Index size, Index numOfThreads, ScratchArena* arena = nullptr) : ptr(nullptr), count(size), numOfThreads(numOfThreads), isMapped(false), isConstructed(false), arena(arena)
 				{
-					for (Index i = l; i < r; i++)
-					{
-						std::memcpy(&vu[i], &v[i], sizeof(T));
-						vu[i] = (vu[i] >> SIGN_SHIFT) ? ~vu[i] : vu[i] ^ SIGN_MASK;
-					}
+					if (arena)
+						ptr = static_cast<T*>(arena->acquire(size * sizeof(T), alignof(T), isMapped));
+					else
+						ptr = static_cast<T*>(allocateScratch(size * sizeof(T), alignof(T), isMapped));
 				}
-				else
+
+				ScratchBuffer(const ScratchBuffer&) = delete;
+				ScratchBuffer& operator=(const ScratchBuffer&) = delete;
+
+				~ScratchBuffer()
 				{
-					for (Index i = l; i < r; i++)
-					{
-						vu[i] = (vu[i] >> SIGN_SHIFT) ? vu[i] ^ SIGN_MASK : ~vu[i];
-						std::memcpy(&v[i], &vu[i], sizeof(T));
-					}
+					if (isConstructed)
+						std::destroy_n(ptr, count);
+
+					if (arena)
+						arena->release();
+					else
+						freeScratch(ptr, count * sizeof(T), alignof(T), isMapped);
 				}
-			}
 
-			template <typename T, typename U>
-			inline void getUnsignedVector(std::vector<T>& v, std::vector<U>& vu, bool reverse, bool enableMultiThreading)
+				std::span<T> span() { return std::span<T>(ptr, count); }
+
+				// slots are raw storage that has to be constructed before anything but a constructing scatter writes it
+				bool isRaw() const { return !std::is_trivially_copyable_v<T> && !isConstructed; }
+
+				void setConstructed() { isConstructed = true; }
+
+				void construct()
+				{
+					if (!isRaw())
+						return;
+
+					if (numOfThreads <= 1)
+					{
+						std::uninitialized_value_construct_n(ptr, count);
+					}
+					else
+					{
+						Index bucketSize = count / numOfThreads;
+						parallelFor(numOfThreads, [this, bucketSize](Index i) {
+							Index start = i * bucketSize;
+							Index end = (i == numOfThreads - 1) ? count : start + bucketSize;
+							std::uninitialized_value_construct_n(ptr + start, end - start);
+						});
+					}
+
+					isConstructed = true;
+				}
+
+			private:
+				T* ptr;
+				Index count;
+				Index numOfThreads;
+				bool isMapped;
+				bool isConstructed;
+				ScratchArena* arena;
+			};
+
+			// Scatters item into dst[i], constructing the slot when it is still raw (the first scatter into a ScratchBuffer
+			// of a type that is not trivially copyable).
+			template <typename T>
+			inline void putItem(std::span<T> dst, Index i, T&& item, bool construct)
+			{
+				if constexpr (!std::is_trivially_copyable_v<T>)
+				{
+					if (construct)
+					{
+						std::construct_at(dst.data() + i, std::move(item));
+						return;
+					}
+				}
+
+				dst[i] = std::move(item);
+			}
+
+			// State behind radix_sort::plan: the last strategy decision, the size class (bit width of the size) it holds for
+			// and the scratch every execution borrows.
+			struct Plan
+			{
+				Report decision;
+				Index sizeClass = 0;
+				ScratchArena arena;
+
+				bool covers(Index size) const
+				{
+					return decision.strategy != Strategy::AUTO && static_cast<Index>(std::bit_width(size)) == sizeClass;
+				}
+			};
+
+			inline ScratchArena* getArena(const Options& options)
+			{
+				return (options.plan) ? &options.plan->arena : options.workspace;
+			}
+
+			// Moves src into dst in the same chunks the parallel passes use.
+			template <typename T>
+			inline void moveBuffer(std::span<T> src, std::span<T> dst, Index numOfThreads)
+			{
+				const Index SIZE = src.size();
+
+				if (numOfThreads <= 1)
+				{
+					std::move(src.begin(), src.end(), dst.begin());
+					return;
+				}
+
+				Index bucketSize = SIZE / numOfThreads;
+				parallelFor(numOfThreads, [&src, &dst, SIZE, bucketSize, numOfThreads](Index i) {
+					Index start = i * bucketSize;
+					Index end = (i == numOfThreads - 1) ? SIZE : start + bucketSize;
+					std::move(src.begin() + start, src.begin() + end, dst.begin() + start);
+				});
+			}
+
+			// ========================
+			// -----Work Stealing-----
+			// ========================
+
+			// Chase-Lev deque of regions. The owning worker pushes and pops at the bottom without contention,
+			// other workers steal from the top, which holds the oldest (and therefore largest) regions.
+			class RegionDeque
+			{
+			public:
+				RegionDeque() : top(0), bottom(0), buffer(nullptr)
+				{
+					retired.emplace_back(std::make_unique<Buffer>(INITIAL_CAPACITY));
+					buffer.store(retired.back().get(), std::memory_order_relaxed);
+				}
+
+				RegionDeque(const RegionDeque&) = delete;
+				RegionDeque& operator=(const RegionDeque&) = delete;
+
+				// owner only
+				void push(const Region& region)
+				{
+					std::int64_t b = bottom.load(std::memory_order_relaxed);
+					std::int64_t t = top.load(std::memory_order_acquire);
+					Buffer* a = buffer.load(std::memory_order_relaxed);
+
+					if (b - t >= a->capacity)
+						a = grow(a, t, b);
+
+					a->put(b, region);
+					bottom.store(b + 1, std::memory_order_release);
+				}
+
+				// owner only
+				bool pop(Region& region)
+				{
+					std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+					Buffer* a = buffer.load(std::memory_order_relaxed);
+					bottom.store(b, std::memory_order_seq_cst);
+					std::int64_t t = top.load(std::memory_order_seq_cst);
+
+					if (t > b)
+					{
+						bottom.store(b + 1, std::memory_order_relaxed);
+						return false;
+					}
+
+					region = a->get(b);
+					if (t == b)
+					{
+						bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+						bottom.store(b + 1, std::memory_order_relaxed);
+						return won;
+					}
+
+					return true;
+				}
+
+				bool steal(Region& region)
+				{
+					std::int64_t t = top.load(std::memory_order_seq_cst);
+					std::int64_t b = bottom.load(std::memory_order_seq_cst);
+
+					if (t >= b)
+						return false;
+
+					Buffer* a = buffer.load(std::memory_order_acquire);
+					region = a->get(t);
+					return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+				}
+
+				// size of the region a thief would get, 0 if the deque looks empty (racy, only used as a hint)
+				Index peekTopSize() const
+				{
+					std::int64_t t = top.load(std::memory_order_seq_cst);
+					std::int64_t b = bottom.load(std::memory_order_seq_cst);
+
+					if (t >= b)
+						return 0;
+
+					const Buffer* a = buffer.load(std::memory_order_acquire);
+					const Slot& slot = a->slots[t & a->mask];
+					return slot.r.load(std::memory_order_relaxed) - slot.l.load(std::memory_order_relaxed);
+				}
+
+			private:
+				static constexpr std::int64_t INITIAL_CAPACITY = 256;
+
+				// region fields are stored as relaxed atomics, a thief may read a slot the owner is overwriting,
+				// in which case its CAS on top fails and the torn copy is discarded
+				struct Slot
+				{
+					std::atomic<Index> l;
+					std::atomic<Index> r;
+					std::atomic<Index> len;
+					std::atomic<Index> curShiftOrIndex;
+					std::atomic<bool> inTmp;
+				};
+
+				struct Buffer
+				{
+					std::int64_t capacity;
+					std::int64_t mask;
+					std::unique_ptr<Slot[]> slots;
+
+					explicit Buffer(std::int64_t capacity) : capacity(capacity), mask(capacity - 1), slots(new Slot[capacity]) {}
+
+					void put(std::int64_t i, const Region& region)
+					{
+						Slot& slot = slots[i & mask];
+						slot.l.store(region.l, std::memory_order_relaxed);
+						slot.r.store(region.r, std::memory_order_relaxed);
+						slot.len.store(region.len, std::memory_order_relaxed);
+						slot.curShiftOrIndex.store(region.curShiftOrIndex, std::memory_order_relaxed);
+						slot.inTmp.store(region.inTmp, std::memory_order_relaxed);
+					}
+
+					Region get(std::int64_t i) const
+					{
+						const Slot& slot = slots[i & mask];
+						return Region(
+							slot.l.load(std::memory_order_relaxed), slot.r.load(std::memory_order_relaxed),
+							slot.len.load(std::memory_order_relaxed), slot.curShiftOrIndex.load(std::memory_order_relaxed),
+							slot.inTmp.load(std::memory_order_relaxed)
+						);
+					}
+				};
+
+				std::atomic<std::int64_t> top;
+				std::atomic<std::int64_t> bottom;
+				std::atomic<Buffer*> buffer;
+				std::vector<std::unique_ptr<Buffer>> retired; // thieves may still read old buffers, freed with the deque
+
+				Buffer* grow(Buffer* a, std::int64_t t, std::int64_t b)
+				{
+					retired.emplace_back(std::make_unique<Buffer>(a->capacity << 1));
+					Buffer* grown = retired.back().get();
+
+					for (std::int64_t i = t; i < b; i++)
+						grown->put(i, a->get(i));
+
+					buffer.store(grown, std::memory_order_release);
+					return grown;
+				}
+			};
+
+			// One deque per worker plus a count of published regions that are not fully sorted yet.
+			// The sort is finished once that count drops to zero, since only a worker holding a region can publish new ones.
+			// Workers that find nothing to steal park on an epoch counter (a futex on Linux, WaitOnAddress on Windows)
+			// and are woken when a region is published or the sort finishes.
+			class RegionScheduler
+			{
+			public:
+				explicit RegionScheduler(Index numOfWorkers) : numOfWorkers(numOfWorkers), deques(new RegionDeque[numOfWorkers]), pending(0), epoch(0), sleepers(0) {}
+
+				void publish(Index workerIndex, const Region& region)
+				{
+					pending.fetch_add(1, std::memory_order_relaxed);
+					deques[workerIndex].push(region);
+
+					if (sleepers.load(std::memory_order_seq_cst) > 0)
+					{
+						epoch.fetch_add(1, std::memory_order_seq_cst);
+						epoch.notify_one();
+					}
+				}
+
+				// pops the worker's own newest region, otherwise steals the largest region pending in another deque
+				bool acquire(Index workerIndex, Region& region)
+				{
+					if (deques[workerIndex].pop(region))
+						return true;
+
+					while (true)
+					{
+						Index victim = numOfWorkers;
+						Index victimSize = 0;
+
+						for (Index i = 0; i < numOfWorkers; i++)
+						{
+							if (i == workerIndex)
+								continue;
+
+							Index size = deques[i].peekTopSize();
+							if (size > victimSize)
+							{
+								victim = i;
+								victimSize = size;
+							}
+						}
+
+						if (victim == numOfWorkers)
+							return false;
+
+						if (deques[victim].steal(region))
+							return true;
+					}
+				}
+
+				void complete()
+				{
+					if (pending.fetch_sub(1, std::memory_order_seq_cst) == 1)
+					{
+						epoch.fetch_add(1, std::memory_order_seq_cst);
+						epoch.notify_all();
+					}
+				}
+
+				bool finished() const
+				{
+					return pending.load(std::memory_order_seq_cst) == 0;
+				}
+
+				// blocks until a region may be available or the sort finished, spurious returns are allowed
+				void park()
+				{
+					std::uint32_t seen = epoch.load(std::memory_order_seq_cst);
+					sleepers.fetch_add(1, std::memory_order_seq_cst);
+
+					// re-check after announcing ourselves, a publisher that missed the announcement pushed before it
+					if (!finished() && !hasWork())
+						epoch.wait(seen, std::memory_order_seq_cst);
+
+					sleepers.fetch_sub(1, std::memory_order_seq_cst);
+				}
+
+			private:
+				Index numOfWorkers;
+				std::unique_ptr<RegionDeque[]> deques;
+				std::atomic<Index> pending;
+				std::atomic<std::uint32_t> epoch;
+				std::atomic<Index> sleepers;
+
+				bool hasWork() const
+				{
+					for (Index i = 0; i < numOfWorkers; i++)
+					{
+						if (deques[i].peekTopSize())
+							return true;
+					}
+
+					return false;
+				}
+			};
+
+			// Per-worker MSD state, kept across every region the worker sorts so the level loop never allocates: the histograms,
+			// the per-thread histograms of a split count, the digit histograms of an LSD finish and the local region stack. The stack holds at most one level's
+			// buckets per level of depth, it starts at one level and grows on demand instead of being sized from the input.
+			struct MsdWorkspace
+			{
+				std::vector<Index> count;
+				std::vector<Index> prefix;
+				std::vector<std::vector<Index>> counts;
+				std::vector<Region> regions;
+				std::vector<Index> digitCounts; // every remaining digit of a region finished by an LSD
+				bool isTmpRaw = false; // the first scatter constructs tmp's slots (see ScratchBuffer), set by the serial sort only
+
+				explicit MsdWorkspace(Index allocSize) : count(allocSize), prefix(allocSize)
+				{
+					regions.reserve(allocSize);
+				}
+
+				// numOfThreads zeroed histograms, only allocated when the team size changes
+				std::vector<std::vector<Index>>& getCounts(Index numOfThreads)
+				{
+					if (counts.size() != numOfThreads)
+						counts.resize(numOfThreads, std::vector<Index>(count.size()));
+
+					for (auto& chunkCount : counts)
+						std::fill(chunkCount.begin(), chunkCount.end(), 0);
+
+					return counts;
+				}
+			};
+
+			// =================
+			// -----Profile-----
+			// =================
+
+			// Machine specific thresholds for one key width, written by radix_sort::calibrate.
+			struct ProfileEntry
+			{
+				Index multiThreadingThreshold = MULTI_THREADING_THRESHOLD;
+				Index globalBucketThreshold = GLOBAL_BUCKET_THRESHOLD;
+				Index insertionSortThresholdAll = INSERTION_SORT_THRESHOLD_ALL;
+			};
+
+			// Per key width thresholds, PROFILE_PATH is loaded on first use and the built-in constants are kept when it is missing.
+			// File format: one "<key bytes> <multi-threading threshold> <global bucket threshold> <insertion sort threshold>" line per width, '#' starts a comment.
+			class Profile
+			{
+			public:
+				static Profile& instance()
+				{
+					static Profile profile;
+					return profile;
+				}
+
+				Profile(const Profile&) = delete;
+				Profile& operator=(const Profile&) = delete;
+
+				bool load(const std::string& path)
+				{
+					std::ifstream file(path);
+					if (!file)
+						return false;
+
+					std::array<ProfileEntry, PROFILE_WIDTHS> loaded;
+					std::string line;
+
+					while (std::getline(file, line))
+					{
+						if (line.empty() || line[0] == '#')
+							continue;
+
+						Index bytes = 0;
+						ProfileEntry entry;
+						std::istringstream stream(line);
+
+						if (!(stream >> bytes >> entry.multiThreadingThreshold >> entry.globalBucketThreshold >> entry.insertionSortThresholdAll))
+							return false;
+
+						if (!std::has_single_bit(bytes) || bytes > (static_cast<Index>(1) << (PROFILE_WIDTHS - 1)))
+							return false;
+
+						loaded[getWidthIndex(bytes)] = entry;
+					}
+
+					std::lock_guard lock(mutex);
+					entries = loaded;
+					return true;
+				}
+
+				bool save(const std::string& path) const
+				{
+					std::ofstream file(path);
+					if (!file)
+						return false;
+
+					std::lock_guard lock(mutex);
+					file << "# key bytes, multi-threading threshold, global bucket threshold, insertion sort threshold\n";
+
+					for (Index i = 0; i < PROFILE_WIDTHS; i++)
+					{
+						file << (static_cast<Index>(1) << i) << ' ' << entries[i].multiThreadingThreshold << ' '
+							<< entries[i].globalBucketThreshold << ' ' << entries[i].insertionSortThresholdAll << '\n';
+					}
+
+					return static_cast<bool>(file);
+				}
+
+				ProfileEntry get(Index bytes) const
+				{
+					std::lock_guard lock(mutex);
+					return entries[getWidthIndex(bytes)];
+				}
+
+				void set(Index bytes, const ProfileEntry& entry)
+				{
+					std::lock_guard lock(mutex);
+					entries[getWidthIndex(bytes)] = entry;
+				}
+
+			private:
+				mutable std::mutex mutex;
+				std::array<ProfileEntry, PROFILE_WIDTHS> entries;
+
+				Profile()
+				{
+					load(PROFILE_PATH);
+				}
+
+				static Index getWidthIndex(Index bytes)
+				{
+					return std::min<Index>(std::bit_width(bytes) - 1, PROFILE_WIDTHS - 1);
+				}
+			};
+
+			// Options with the profile thresholds of Key's width. Strings have no width and keep the built-in constants.
+			template <typename Key>
+			inline Options getProfileOptions()
+			{
+				Options options;
+
+				if constexpr (std::integral<Key> || is_floating_point<Key>)
+				{
+					ProfileEntry entry = Profile::instance().get(sizeof(Key));
+
+					options.multiThreadingThreshold = entry.multiThreadingThreshold;
+					options.minElementsPerThread = std::max<Index>(entry.multiThreadingThreshold >> 1, 1);
+					options.parallelScatterThreshold = entry.multiThreadingThreshold << 1;
+					options.globalBucketThreshold = entry.globalBucketThreshold;
+					options.insertionSortThresholdAll = entry.insertionSortThresholdAll;
+				}
+
+				return options;
+			}
+
+			// ======================
+			// -----SIMD Kernels-----
+			// ======================
+
+			enum class SimdLevel { SCALAR, AVX2, AVX512 };
+
+			inline SimdLevel detectSimdLevel()
+			{
+#if defined(RADIX_SORT_X86) && defined(_MSC_VER)
+				int info[4];
+				__cpuid(info, 0);
+				if (info[0] < 7)
+					return SimdLevel::SCALAR;
+
+				// the OS has to save the ymm (and zmm) state, not only the cpu support it
+				__cpuid(info, 1);
+				if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)))
+					return SimdLevel::SCALAR;
+
+				unsigned long long xcr0 = _xgetbv(0);
+				__cpuidex(info, 7, 0);
+
+				if ((info[1] & (1 << 16)) && (xcr0 & 0xE6) == 0xE6)
+					return SimdLevel::AVX512;
+				if ((info[1] & (1 << 5)) && (xcr0 & 0x6) == 0x6)
+					return SimdLevel::AVX2;
+#elif defined(RADIX_SORT_X86)
+				__builtin_cpu_init();
+
+				if (__builtin_cpu_supports("avx512f"))
+					return SimdLevel::AVX512;
+				if (__builtin_cpu_supports("avx2"))
+					return SimdLevel::AVX2;
+#endif
+				return SimdLevel::SCALAR;
+			}
+
+			// widest kernel set the running cpu supports, detected once so a single binary runs on every host
+			inline SimdLevel getSimdLevel()
+			{
+				static const SimdLevel level = detectSimdLevel();
+				return level;
+			}
+
+			template <typename Counter, typename GetDigit>
+			inline void countSubHistograms(Index n, Index* count, GetDigit&& getDigit)
+			{
+				std::array<std::array<Counter, BASE>, SUB_HISTOGRAMS> counts = {};
+				Index i = 0;
+
+				[&counts, &getDigit, &i, n]<Index... SUBS>(std::integer_sequence<Index, SUBS...>) {
+					for (; i + SUB_HISTOGRAMS <= n; i += SUB_HISTOGRAMS)
+						((counts[SUBS][getDigit(i + SUBS)]++), ...);
+				}(std::make_integer_sequence<Index, SUB_HISTOGRAMS>{});
+
+				for (; i < n; i++)
+					counts[0][getDigit(i)]++;
+
+				for (Index b = 0; b < BASE; b++)
+				{
+					for (const auto& sub : counts)
+						count[b] += sub[b];
+				}
+			}
+
+			// count[getDigit(i)]++ for i in [0, n), spread over SUB_HISTOGRAMS interleaved histograms so consecutive equal digits
+			// (runs of duplicates, sorted input) increment different counters instead of waiting on each other's stores.
+			// Wider digits count into one histogram, SUB_HISTOGRAMS copies of theirs would not stay in the cache.
+			// The sub histograms hold 32-bit counters whenever n fits them, half the cache lines to keep hot.
+			template <Index BITS = SHIFT_BITS, typename GetDigit>
+			inline void countDigit(Index n, Index* count, GetDigit&& getDigit)
+			{
+				if (BITS != SHIFT_BITS || n < SUB_HISTOGRAM_THRESHOLD)
+				{
+					for (Index i = 0; i < n; i++)
+						count[getDigit(i)]++;
+				}
+				else if (n <= SMALL_INDEX_LIMIT)
+					countSubHistograms<SmallIndex>(n, count, getDigit);
+				else
+					countSubHistograms<Index>(n, count, getDigit);
+			}
+
+			// Float bits (read as U) to radix-ordered unsigned keys, or back when reverse. src and dst are raw storage of different
+			// types (float and U), so they are only accessed through memcpy and the vector loads, which may alias anything.
+			template <typename U>
+			inline void convertFloatBitsScalar(const std::byte* src, std::byte* dst, Index n, bool reverse)
+			{
+				constexpr Index SIGN_SHIFT = (sizeof(U) * 8) - 1;
+				constexpr U SIGN_MASK = static_cast<U>(1) << SIGN_SHIFT;
+
+				for (Index i = 0; i < n; i++)
+				{
+					U bits;
+					std::memcpy(&bits, src + i * sizeof(U), sizeof(U));
+
+					if (!reverse)
+						bits = (bits >> SIGN_SHIFT) ? ~bits : bits ^ SIGN_MASK;
+					else
+						bits = (bits >> SIGN_SHIFT) ? bits ^ SIGN_MASK : ~bits;
+
+					std::memcpy(dst + i * sizeof(U), &bits, sizeof(U));
+				}
+			}
+
+#ifdef RADIX_SORT_X86
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized" // GCC 12 AVX-512 headers start from self-initialized undefined vectors
+#endif
+			template <typename U>
+			RADIX_SORT_TARGET("avx2") inline void convertFloatBitsAvx2(const std::byte* src, std::byte* dst, Index n, bool reverse)
+			{
+				constexpr Index LANES = 32 / sizeof(U);
+				constexpr Index SIGN_SHIFT = (sizeof(U) * 8) - 1;
+
+				const __m256i SIGN_MASK = (sizeof(U) == 4) ? _mm256_set1_epi32(static_cast<int>(1u << SIGN_SHIFT)) : _mm256_set1_epi64x(static_cast<long long>(1ull << SIGN_SHIFT));
+				const __m256i ZERO = _mm256_setzero_si256();
+				const __m256i ONES = _mm256_set1_epi32(-1);
+				Index i = 0;
+
+				for (; i + LANES <= n; i += LANES)
+				{
+					__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * sizeof(U)));
+
+					// all ones where the top bit is set
+					__m256i top = (sizeof(U) == 4) ? _mm256_srai_epi32(v, 31) : _mm256_cmpgt_epi64(ZERO, v);
+
+					// forward: negatives are inverted, positives get their sign bit set
+					// reverse: a set top bit marks a former positive (clear it), the rest were negatives (invert back)
+					__m256i flip = (reverse) ? _mm256_andnot_si256(top, ONES) : top;
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * sizeof(U)), _mm256_xor_si256(v, _mm256_or_si256(flip, SIGN_MASK)));
+				}
+
+				convertFloatBitsScalar<U>(src + i * sizeof(U), dst + i * sizeof(U), n - i, reverse);
+			}
+
+			template <typename U>
+			RADIX_SORT_TARGET("avx512f") inline void convertFloatBitsAvx512(const std::byte* src, std::byte* dst, Index n, bool reverse)
+			{
+				constexpr Index LANES = 64 / sizeof(U);
+				constexpr Index SIGN_SHIFT = (sizeof(U) * 8) - 1;
+
+				const __m512i SIGN_MASK = (sizeof(U) == 4) ? _mm512_set1_epi32(static_cast<int>(1u << SIGN_SHIFT)) : _mm512_set1_epi64(static_cast<long long>(1ull << SIGN_SHIFT));
+				const __m512i ONES = _mm512_set1_epi32(-1);
+				Index i = 0;
+
+				for (; i + LANES <= n; i += LANES)
+				{
+					__m512i v = _mm512_loadu_si512(src + i * sizeof(U));
+					__m512i top = (sizeof(U) == 4) ? _mm512_srai_epi32(v, 31) : _mm512_srai_epi64(v, 63);
+					__m512i flip = (reverse) ? _mm512_andnot_si512(top, ONES) : top;
+					_mm512_storeu_si512(dst + i * sizeof(U), _mm512_xor_si512(v, _mm512_or_si512(flip, SIGN_MASK)));
+				}
+
+				convertFloatBitsScalar<U>(src + i * sizeof(U), dst + i * sizeof(U), n - i, reverse);
+			}
+
+			template <typename U>
+			RADIX_SORT_TARGET("avx2") inline U orKeysAvx2(const U* keys, Index n)
+			{
+				constexpr Index LANES = 32 / sizeof(U);
+
+				__m256i acc = _mm256_setzero_si256();
+				Index i = 0;
+
+				for (; i + LANES <= n; i += LANES)
+					acc = _mm256_or_si256(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)));
+
+				alignas(32) U lanes[LANES];
+				_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+
+				U bits = 0;
+				for (const auto& lane : lanes)
+					bits |= lane;
+				for (; i < n; i++)
+					bits |= keys[i];
+
+				return bits;
+			}
+
+			template <typename U>
+			RADIX_SORT_TARGET("avx512f") inline U orKeysAvx512(const U* keys, Index n)
+			{
+				constexpr Index LANES = 64 / sizeof(U);
+
+				__m512i acc = _mm512_setzero_si512();
+				Index i = 0;
+
+				for (; i + LANES <= n; i += LANES)
+					acc = _mm512_or_si512(acc, _mm512_loadu_si512(keys + i));
+
+				alignas(64) U lanes[LANES];
+				_mm512_store_si512(lanes, acc);
+
+				U bits = 0;
+				for (const auto& lane : lanes)
+					bits |= lane;
+				for (; i < n; i++)
+					bits |= keys[i];
+
+				return bits;
+			}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+			template <typename U>
+			inline void convertFloatBits(const std::byte* src, std::byte* dst, Index n, bool reverse)
+			{
+#ifdef RADIX_SORT_X86
+				switch (getSimdLevel())
+				{
+					case SimdLevel::AVX512:
+						convertFloatBitsAvx512<U>(src, dst, n, reverse);
+						return;
+					case SimdLevel::AVX2:
+						convertFloatBitsAvx2<U>(src, dst, n, reverse);
+						return;
+					default:
+						break;
+				}
+#endif
+				convertFloatBitsScalar<U>(src, dst, n, reverse);
+			}
+
+			// bitwise OR of n raw unsigned keys, its bit width is the bit width of the largest key
+			template <typename U>
+			inline U orKeys(const U* keys, Index n)
+			{
+#ifdef RADIX_SORT_X86
+				if constexpr (sizeof(U) >= 4)
+				{
+					switch (getSimdLevel())
+					{
+						case SimdLevel::AVX512:
+							return orKeysAvx512(keys, n);
+						case SimdLevel::AVX2:
+							return orKeysAvx2(keys, n);
+						default:
+							break;
+					}
+				}
+#endif
+				U bits = 0;
+				for (Index i = 0; i < n; i++)
+					bits |= keys[i];
+
+				return bits;
+			}
+
+			// =====================
+			// -----Small Sorts-----
+			// =====================
+
+			// comparator pairs of a sorting network, at most the 191 of Batcher's network for SORTING_NETWORK_MAX items
+			struct SortingNetwork
+			{
+				std::array<std::array<std::uint8_t, 2>, 192> pairs = {};
+				Index size = 0;
+			};
+
+			// Batcher's odd-even merge sort for n items, built for the next power of two. Comparators that touch a slot past n are
+			// dropped: padding there would hold the largest keys, which never move.
+			inline constexpr SortingNetwork makeSortingNetwork(Index n)
+			{
+				SortingNetwork network;
+				const Index SIZE = std::bit_ceil(std::max<Index>(n, 1));
+
+				for (Index p = 1; p < SIZE; p <<= 1)
+				{
+					for (Index k = p; k >= 1; k >>= 1)
+					{
+						for (Index j = k % p; j + k < SIZE; j += 2 * k)
+						{
+							for (Index i = 0; i < std::min(k, SIZE - j - k); i++)
+							{
+								if ((i + j) / (2 * p) == (i + j + k) / (2 * p) && i + j + k < n)
+									network.pairs[network.size++] = { static_cast<std::uint8_t>(i + j), static_cast<std::uint8_t>(i + j + k) };
+							}
+						}
+					}
+				}
+
+				return network;
+			}
+
+			template <Index N>
+			inline constexpr SortingNetwork SORTING_NETWORK = makeSortingNetwork(N);
+
+			// branch-free compare-exchange, a and b leave as min and max
+			template <typename K>
+			inline void compareSwap(K& a, K& b)
+			{
+				const K x = a;
+				const K y = b;
+				const bool isSwapped = y < x;
+				a = (isSwapped) ? y : x;
+				b = (isSwapped) ? x : y;
+			}
+
+			// The same on (key, index) pairs, ordered by key and then index, which keeps equal keys in their original order.
+			// The swap is masked, compilers turn the two-part compare into branches when it feeds selects.
+			template <typename K, typename I>
+			inline void compareSwap(K& ka, I& ia, K& kb, I& ib)
+			{
+				using U = t2u<K>;
+
+				const U x = static_cast<U>(ka);
+				const U y = static_cast<U>(kb);
+				const I xi = ia;
+				const I yi = ib;
+				const bool isSwapped = (kb < ka) | ((x == y) & (yi < xi));
+				const U keyMask = (x ^ y) & (static_cast<U>(0) - static_cast<U>(isSwapped));
+				const I indexMask = (xi ^ yi) & (static_cast<I>(0) - static_cast<I>(isSwapped));
+				ka = static_cast<K>(x ^ keyMask);
+				kb = static_cast<K>(y ^ keyMask);
+				ia = xi ^ indexMask;
+				ib = yi ^ indexMask;
+			}
+
+			template <Index N, typename K>
+			inline void applySortingNetwork(K* keys)
+			{
+				[keys]<Index... C>(std::integer_sequence<Index, C...>) {
+					(compareSwap(keys[SORTING_NETWORK<N>.pairs[C][0]], keys[SORTING_NETWORK<N>.pairs[C][1]]), ...);
+				}(std::make_integer_sequence<Index, SORTING_NETWORK<N>.size>{});
+			}
+
+			// the pairs are copied out first, keys and indices of one type could alias and would be reloaded after every store
+			template <Index N, typename K, typename I>
+			inline void applySortingNetwork(K* keys, I* indices)
+			{
+				std::array<K, N> k;
+				std::array<I, N> x;
+				std::copy_n(keys, N, k.begin());
+				std::copy_n(indices, N, x.begin());
+
+				[&k, &x]<Index... C>(std::integer_sequence<Index, C...>) {
+					(compareSwap(k[SORTING_NETWORK<N>.pairs[C][0]], x[SORTING_NETWORK<N>.pairs[C][0]],
+						k[SORTING_NETWORK<N>.pairs[C][1]], x[SORTING_NETWORK<N>.pairs[C][1]]), ...);
+				}(std::make_integer_sequence<Index, SORTING_NETWORK<N>.size>{});
+
+				std::copy_n(k.begin(), N, keys);
+				std::copy_n(x.begin(), N, indices);
+			}
+
+			// Sorts n <= SORTING_NETWORK_MAX keys with the network for n. The networks are unrolled at compile time
+			// and picked from a table, the call is the only branch.
+			template <typename K>
+			inline void sortNetwork(K* keys, Index n)
+			{
+				static constexpr auto NETWORKS = []<Index... NS>(std::integer_sequence<Index, NS...>) {
+					return std::array<void (*)(K*), sizeof...(NS)>{ &applySortingNetwork<NS, K>... };
+				}(std::make_integer_sequence<Index, SORTING_NETWORK_MAX + 1>{});
+
+				NETWORKS[n](keys);
+			}
+
+			// the same on n <= SORTING_NETWORK_PAIRS_MAX keys with their indices alongside
+			template <typename K, typename I>
+			inline void sortNetwork(K* keys, I* indices, Index n)
+			{
+				static constexpr auto NETWORKS = []<Index... NS>(std::integer_sequence<Index, NS...>) {
+					return std::array<void (*)(K*, I*), sizeof...(NS)>{ &applySortingNetwork<NS, K, I>... };
+				}(std::make_integer_sequence<Index, SORTING_NETWORK_PAIRS_MAX + 1>{});
+
+				NETWORKS[n](keys, indices);
+			}
+
+#ifdef RADIX_SORT_X86
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized" // the permutes start from the same self-initialized undefined vectors
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+			// lanes i with i & d set, the ones holding the larger item of a compare at distance d (or of a descending block of d)
+			template <Index LANES>
+			inline constexpr std::uint32_t getLaneBits(Index d)
+			{
+				std::uint32_t bits = 0;
+				for (Index i = 0; i < LANES; i++)
+				{
+					if (i & d)
+						bits |= static_cast<std::uint32_t>(1) << i;
+				}
+
+				return bits;
+			}
+
+			template <typename K>
+			RADIX_SORT_TARGET("avx512f") inline __m512i minAvx512(__m512i a, __m512i b)
+			{
+				if constexpr (sizeof(K) == 4)
+					return (std::signed_integral<K>) ? _mm512_min_epi32(a, b) : _mm512_min_epu32(a, b);
+				else
+					return (std::signed_integral<K>) ? _mm512_min_epi64(a, b) : _mm512_min_epu64(a, b);
+			}
+
+			template <typename K>
+			RADIX_SORT_TARGET("avx512f") inline __m512i maxAvx512(__m512i a, __m512i b)
+			{
+				if constexpr (sizeof(K) == 4)
+					return (std::signed_integral<K>) ? _mm512_max_epi32(a, b) : _mm512_max_epu32(a, b);
+				else
+					return (std::signed_integral<K>) ? _mm512_max_epi64(a, b) : _mm512_max_epu64(a, b);
+			}
+
+			// lane i of v moved to lane i ^ d
+			template <typename K>
+			RADIX_SORT_TARGET("avx512f") inline __m512i swapLanesAvx512(__m512i v, Index d)
+			{
+				if constexpr (sizeof(K) == 4)
+				{
+					const __m512i IDX = _mm512_xor_si512(_mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0), _mm512_set1_epi32(static_cast<int>(d)));
+					return _mm512_permutexvar_epi32(IDX, v);
+				}
+				else
+				{
+					const __m512i IDX = _mm512_xor_si512(_mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0), _mm512_set1_epi64(static_cast<long long>(d)));
+					return _mm512_permutexvar_epi64(IDX, v);
+				}
+			}
+
+			// One step of a bitonic sort over R registers: items p and p ^ J are compared, the larger one goes up unless the block
+			// of BLOCK items holding p is descending (p & BLOCK). Distances of a register or more pair whole registers.
+			template <Index R, typename K, Index BLOCK, Index J>
+			RADIX_SORT_TARGET("avx512f") inline void bitonicStepAvx512(__m512i* regs)
+			{
+				constexpr Index LANES = 64 / sizeof(K);
+
+				if constexpr (J >= LANES)
+				{
+					constexpr Index D = J / LANES;
+
+					for (Index a = 0; a < R; a++)
+					{
+						if (a & D)
+							continue;
+
+						__m512i lo = minAvx512<K>(regs[a], regs[a + D]);
+						__m512i hi = maxAvx512<K>(regs[a], regs[a + D]);
+						bool isAscending = ((a * LANES) & BLOCK) == 0;
+						regs[a] = (isAscending) ? lo : hi;
+						regs[a + D] = (isAscending) ? hi : lo;
+					}
+				}
+				else
+				{
+					constexpr std::uint32_t ALL = (static_cast<std::uint32_t>(1) << LANES) - 1;
+					constexpr std::uint32_t J_BITS = getLaneBits<LANES>(J);
+					constexpr std::uint32_t BLOCK_BITS = (BLOCK < LANES) ? getLaneBits<LANES>(BLOCK) : 0;
+
+					for (Index a = 0; a < R; a++)
+					{
+						std::uint32_t descending = (BLOCK < LANES) ? BLOCK_BITS : ((((a * LANES) & BLOCK) != 0) ? ALL : 0);
+						std::uint32_t takeMax = J_BITS ^ descending;
+						__m512i other = swapLanesAvx512<K>(regs[a], J);
+						__m512i lo = minAvx512<K>(regs[a], other);
+						__m512i hi = maxAvx512<K>(regs[a], other);
+
+						if constexpr (sizeof(K) == 4)
+							regs[a] = _mm512_mask_blend_epi32(static_cast<__mmask16>(takeMax), lo, hi);
+						else
+							regs[a] = _mm512_mask_blend_epi64(static_cast<__mmask8>(takeMax), lo, hi);
+					}
+				}
+			}
+
+			// the steps sorting blocks of BLOCK items out of bitonic halves, distances from half a block down to 1
+			template <Index R, typename K, Index BLOCK, Index... STEPS>
+			RADIX_SORT_TARGET("avx512f") inline void bitonicLevelAvx512(__m512i* regs, std::integer_sequence<Index, STEPS...>)
+			{
+				(bitonicStepAvx512<R, K, BLOCK, (BLOCK >> (STEPS + 1))>(regs), ...);
+			}
+
+			// every level of a bitonic sort, blocks of 2, 4, ... up to all R * LANES items
+			template <Index R, typename K, Index... LEVELS>
+			RADIX_SORT_TARGET("avx512f") inline void bitonicSortAvx512(__m512i* regs, std::integer_sequence<Index, LEVELS...>)
+			{
+				(bitonicLevelAvx512<R, K, (static_cast<Index>(2) << LEVELS)>(regs, std::make_integer_sequence<Index, LEVELS + 1>{}), ...);
+			}
+
+			// Sorts n <= R * LANES keys in R registers, the lanes past n padded with the largest key. Masked loads and stores
+			// never touch memory past n.
+			template <Index R, typename K>
+			RADIX_SORT_TARGET("avx512f") inline void sortKeysAvx512(K* keys, Index n)
+			{
+				constexpr Index LANES = 64 / sizeof(K);
+				constexpr Index LEVELS = std::bit_width(R * LANES) - 1;
+
+				const __m512i PAD = (sizeof(K) == 4) ? _mm512_set1_epi32(static_cast<int>(std::numeric_limits<K>::max())) : _mm512_set1_epi64(static_cast<long long>(std::numeric_limits<K>::max()));
+				__m512i regs[R];
+
+				for (Index a = 0; a < R; a++)
+				{
+					Index count = (n > a * LANES) ? std::min(n - a * LANES, LANES) : 0;
+					std::uint32_t mask = (static_cast<std::uint32_t>(1) << count) - 1;
+
+					if (count == 0)
+						regs[a] = PAD;
+					else if constexpr (sizeof(K) == 4)
+						regs[a] = _mm512_mask_loadu_epi32(PAD, static_cast<__mmask16>(mask), keys + a * LANES);
+					else
+						regs[a] = _mm512_mask_loadu_epi64(PAD, static_cast<__mmask8>(mask), keys + a * LANES);
+				}
+
+				bitonicSortAvx512<R, K>(regs, std::make_integer_sequence<Index, LEVELS>{});
+
+				for (Index a = 0; a < R && a * LANES < n; a++)
+				{
+					Index count = std::min(n - a * LANES, LANES);
+					std::uint32_t mask = (static_cast<std::uint32_t>(1) << count) - 1;
+
+					if constexpr (sizeof(K) == 4)
+						_mm512_mask_storeu_epi32(keys + a * LANES, static_cast<__mmask16>(mask), regs[a]);
+					else
+						_mm512_mask_storeu_epi64(keys + a * LANES, static_cast<__mmask8>(mask), regs[a]);
+				}
+			}
+
+			// lanes where (ka, ia) < (kb, ib), keys compared as signed or unsigned 64-bit integers, indices as unsigned ones
+			template <bool IS_SIGNED>
+			RADIX_SORT_TARGET("avx512f") inline __mmask8 lessPairsAvx512(__m512i ka, __m512i ia, __m512i kb, __m512i ib)
+			{
+				__mmask8 less = (IS_SIGNED) ? _mm512_cmplt_epi64_mask(ka, kb) : _mm512_cmplt_epu64_mask(ka, kb);
+				__mmask8 equal = _mm512_cmpeq_epi64_mask(ka, kb);
+				return less | (equal & _mm512_cmplt_epu64_mask(ia, ib));
+			}
+
+			// bitonicStepAvx512 on (key, index) pairs in 64-bit lanes, keys in keys[], their indices in the same lanes of indices[]
+			template <Index R, bool IS_SIGNED, Index BLOCK, Index J>
+			RADIX_SORT_TARGET("avx512f") inline void bitonicPairStepAvx512(__m512i* keys, __m512i* indices)
+			{
+				constexpr Index LANES = 8;
+
+				if constexpr (J >= LANES)
+				{
+					constexpr Index D = J / LANES;
+
+					for (Index a = 0; a < R; a++)
+					{
+						if (a & D)
+							continue;
+
+						// lanes where a takes b's pair: the smaller ones into an ascending block, the larger ones into a descending one
+						__mmask8 isLess = lessPairsAvx512<IS_SIGNED>(keys[a + D], indices[a + D], keys[a], indices[a]);
+						__mmask8 take = (((a * LANES) & BLOCK) == 0) ? isLess : static_cast<__mmask8>(~isLess);
+
+						__m512i key = keys[a];
+						__m512i index = indices[a];
+						keys[a] = _mm512_mask_blend_epi64(take, key, keys[a + D]);
+						indices[a] = _mm512_mask_blend_epi64(take, index, indices[a + D]);
+						keys[a + D] = _mm512_mask_blend_epi64(take, keys[a + D], key);
+						indices[a + D] = _mm512_mask_blend_epi64(take, indices[a + D], index);
+					}
+				}
+				else
+				{
+					constexpr std::uint32_t ALL = (static_cast<std::uint32_t>(1) << LANES) - 1;
+					constexpr std::uint32_t J_BITS = getLaneBits<LANES>(J);
+					constexpr std::uint32_t BLOCK_BITS = (BLOCK < LANES) ? getLaneBits<LANES>(BLOCK) : 0;
+
+					for (Index a = 0; a < R; a++)
+					{
+						std::uint32_t descending = (BLOCK < LANES) ? BLOCK_BITS : ((((a * LANES) & BLOCK) != 0) ? ALL : 0);
+						std::uint32_t takeMax = J_BITS ^ descending;
+						__m512i otherKey = swapLanesAvx512<std::uint64_t>(keys[a], J);
+						__m512i otherIndex = swapLanesAvx512<std::uint64_t>(indices[a], J);
+
+						// pairs are unique (the padding aside, which is equal to itself), a lane wanting the max takes the other one
+						// exactly when it is not the smaller one
+						__mmask8 take = lessPairsAvx512<IS_SIGNED>(otherKey, otherIndex, keys[a], indices[a]) ^ static_cast<__mmask8>(takeMax);
+						keys[a] = _mm512_mask_blend_epi64(take, keys[a], otherKey);
+						indices[a] = _mm512_mask_blend_epi64(take, indices[a], otherIndex);
+					}
+				}
+			}
+
+			template <Index R, bool IS_SIGNED, Index BLOCK, Index... STEPS>
+			RADIX_SORT_TARGET("avx512f") inline void bitonicPairLevelAvx512(__m512i* keys, __m512i* indices, std::integer_sequence<Index, STEPS...>)
+			{
+				(bitonicPairStepAvx512<R, IS_SIGNED, BLOCK, (BLOCK >> (STEPS + 1))>(keys, indices), ...);
+			}
+
+			template <Index R, bool IS_SIGNED, Index... LEVELS>
+			RADIX_SORT_TARGET("avx512f") inline void bitonicPairSortAvx512(__m512i* keys, __m512i* indices, std::integer_sequence<Index, LEVELS...>)
+			{
+				(bitonicPairLevelAvx512<R, IS_SIGNED, (static_cast<Index>(2) << LEVELS)>(keys, indices, std::make_integer_sequence<Index, LEVELS + 1>{}), ...);
+			}
+
+			// Sorts n <= R * 8 (key, index) pairs by key and then index. Both are widened into 64-bit lanes on the way in
+			// (4 byte keys keep their signedness) and narrowed back on the way out, padding takes the largest key and index.
+			template <Index R, typename K, typename I>
+			RADIX_SORT_TARGET("avx512f") inline void sortPairsAvx512(K* keys, I* indices, Index n)
+			{
+				constexpr Index LANES = 8;
+				constexpr Index LEVELS = std::bit_width(R * LANES) - 1;
+				using W = std::conditional_t<std::signed_integral<K>, std::int64_t, std::uint64_t>;
+
+				alignas(64) W wideKeys[R * LANES];
+				alignas(64) std::uint64_t wideIndices[R * LANES];
+
+				for (Index i = 0; i < n; i++)
+				{
+					wideKeys[i] = static_cast<W>(keys[i]);
+					wideIndices[i] = static_cast<std::uint64_t>(indices[i]);
+				}
+
+				for (Index i = n; i < R * LANES; i++)
+				{
+					wideKeys[i] = std::numeric_limits<W>::max();
+					wideIndices[i] = std::numeric_limits<std::uint64_t>::max();
+				}
+
+				__m512i keyRegs[R];
+				__m512i indexRegs[R];
+
+				for (Index a = 0; a < R; a++)
+				{
+					keyRegs[a] = _mm512_load_si512(wideKeys + a * LANES);
+					indexRegs[a] = _mm512_load_si512(wideIndices + a * LANES);
+				}
+
+				bitonicPairSortAvx512<R, std::signed_integral<K>>(keyRegs, indexRegs, std::make_integer_sequence<Index, LEVELS>{});
+
+				for (Index a = 0; a < R; a++)
+				{
+					_mm512_store_si512(wideKeys + a * LANES, keyRegs[a]);
+					_mm512_store_si512(wideIndices + a * LANES, indexRegs[a]);
+				}
+
+				for (Index i = 0; i < n; i++)
+				{
+					keys[i] = static_cast<K>(wideKeys[i]);
+					indices[i] = static_cast<I>(wideIndices[i]);
+				}
+			}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+			// the fewest registers (a power of two) that hold n keys, up to SMALL_SORT_SIMD_MAX of them
+			template <typename K, Index R = 1>
+			inline void sortKeysSimd(K* keys, Index n)
+			{
+#ifdef RADIX_SORT_X86
+				if constexpr (R * (64 / sizeof(K)) < SMALL_SORT_SIMD_MAX)
+				{
+					if (n > R * (64 / sizeof(K)))
+					{
+						sortKeysSimd<K, R * 2>(keys, n);
+						return;
+					}
+				}
+
+				sortKeysAvx512<R>(keys, n);
+#endif
+			}
+
+			template <typename K, typename I, Index R = 1>
+			inline void sortPairsSimd(K* keys, I* indices, Index n)
+			{
+#ifdef RADIX_SORT_X86
+				if constexpr (R * 8 < SMALL_SORT_SIMD_MAX)
+				{
+					if (n > R * 8)
+					{
+						sortPairsSimd<K, I, R * 2>(keys, indices, n);
+						return;
+					}
+				}
+
+				sortPairsAvx512<R>(keys, indices, n);
+#endif
+			}
+
+			// Small buckets of integer keys, whose equal keys need no order kept: a bitonic sort in AVX-512 registers from
+			// SMALL_SORT_SIMD_MIN to SMALL_SORT_SIMD_MAX keys when the cpu has them, a sorting network up to SORTING_NETWORK_MAX
+			// keys otherwise. Returns false when the bucket is left to the caller's insertion sort.
+			template <typename K>
+			inline bool sortSmallKeys(K* keys, Index n)
+			{
+				if constexpr (sizeof(K) == 4 || sizeof(K) == 8)
+				{
+					if (n >= SMALL_SORT_SIMD_MIN && n <= SMALL_SORT_SIMD_MAX && getSimdLevel() == SimdLevel::AVX512)
+					{
+						sortKeysSimd(keys, n);
+						return true;
+					}
+				}
+
+				if (n <= SORTING_NETWORK_MAX)
+				{
+					sortNetwork(keys, n);
+					return true;
+				}
+
+				return false;
+			}
+
+			// The same on (key, index) pairs of the index path, ordered by key and then index: the indices of equal keys are
+			// ascending before the sort, so this is the stable order.
+			template <typename K, typename I>
+			inline bool sortSmallPairs(K* keys, I* indices, Index n)
+			{
+				if constexpr ((sizeof(K) == 4 || sizeof(K) == 8) && (sizeof(I) == 4 || sizeof(I) == 8))
+				{
+					if (n >= SMALL_SORT_SIMD_MIN && n <= SMALL_SORT_SIMD_MAX && getSimdLevel() == SimdLevel::AVX512)
+					{
+						sortPairsSimd(keys, indices, n);
+						return true;
+					}
+				}
+
+				if (n <= SORTING_NETWORK_PAIRS_MAX)
+				{
+					sortNetwork(keys, indices, n);
+					return true;
+				}
+
+				return false;
+			}
+
+			// Largest MSD bucket finished by a small sort: the insertion sort threshold, raised to SMALL_SORT_SIMD_MAX for keys
+			// the AVX-512 kernels take, which beat another radix pass on every bucket they hold.
+			template <typename K>
+			inline Index getSmallSortThreshold(Index insertionSortThreshold)
+			{
+				if constexpr (std::integral<K> && (sizeof(K) == 4 || sizeof(K) == 8))
+				{
+					if (getSimdLevel() == SimdLevel::AVX512)
+						return std::max(insertionSortThreshold, SMALL_SORT_SIMD_MAX);
+				}
+
+				return insertionSortThreshold;
+			}
+
+			// =========================
+			// -----Scatter Buffers-----
+			// =========================
+
+			// one cache line from an aligned buffer to an aligned destination, bypassing the cache
+			inline void streamLine(void* dst, const void* src)
+			{
+#ifdef RADIX_SORT_X86
+				for (Index i = 0; i < CACHE_LINE_BYTES / sizeof(__m128i); i++)
+					_mm_stream_si128(static_cast<__m128i*>(dst) + i, _mm_load_si128(static_cast<const __m128i*>(src) + i));
+#else
+				std::memcpy(dst, src, CACHE_LINE_BYTES);
+#endif
+			}
+
+			// orders the non-temporal stores before whatever publishes the scattered data to other threads
+			inline void streamFence()
+			{
+#ifdef RADIX_SORT_X86
+				_mm_sfence();
+#endif
+			}
+
+			// Software write combining for one scatter destination. Every bucket gathers its items in a cache line sized buffer
+			// that is written out whole, so a pass touches each destination line once instead of once per item. The first line
+			// of a bucket is cut at the next line boundary, which keeps every later one aligned for non-temporal stores.
+			// Its buffers take 128 KiB with 11-bit digits, so it is allocated on the heap, never on a worker's stack.
+			template <typename T, Index BITS = SHIFT_BITS>
+			class WriteCombiner
+			{
+			public:
+				WriteCombiner(std::span<T> dst, const std::vector<Index>& prefix, bool streaming) : dst(dst.data()), streaming(streaming)
+				{
+					for (Index b = 0; b < BUCKETS; b++)
+					{
+						Index misalignment = (reinterpret_cast<std::uintptr_t>(this->dst + prefix[b]) % CACHE_LINE_BYTES) / sizeof(T);
+
+						next[b] = prefix[b];
+						fill[b] = 0;
+						capacity[b] = LINE - misalignment;
+					}
+				}
+
+				void push(Index digit, const T& item)
+				{
+					Index size = fill[digit];
+					lines[digit][size++] = item;
+
+					if (size == capacity[digit])
+					{
+						flush(digit, size);
+						size = 0;
+					}
+
+					fill[digit] = size;
+				}
+
+				// writes out the partial lines and leaves prefix where a direct scatter would have
+				void finish(std::vector<Index>& prefix)
+				{
+					for (Index b = 0; b < BUCKETS; b++)
+					{
+						std::memcpy(dst + next[b], lines[b].data(), fill[b] * sizeof(T));
+						prefix[b] = next[b] + fill[b];
+					}
+
+					if (streaming)
+						streamFence();
+				}
+
+			private:
+				static constexpr Index LINE = CACHE_LINE_BYTES / sizeof(T);
+				static constexpr Index BUCKETS = DIGIT_BASE<BITS>;
+
+				void flush(Index digit, Index size)
+				{
+					if (streaming && size == LINE)
+						streamLine(dst + next[digit], lines[digit].data());
+					else
+						std::memcpy(dst + next[digit], lines[digit].data(), size * sizeof(T));
+
+					next[digit] += size;
+					capacity[digit] = LINE;
+				}
+
+				alignas(CACHE_LINE_BYTES) std::array<std::array<T, LINE>, BUCKETS> lines;
+				std::array<Index, BUCKETS> next;
+				std::array<Index, BUCKETS> fill;
+				std::array<Index, BUCKETS> capacity;
+				T* dst;
+				bool streaming;
+			};
+
+			// Scatter mode for a pass whose destination holds size items of T. MSD moves every level straight back out of its
+			// destination (copiedBack), non-temporal stores would only push out what is read next, so AUTO scatters it directly.
+			// Buffering alone did not beat a direct scatter on the machines measured, AUTO only picks it with streaming.
+			// 16-bit digits are always scattered directly, a line per bucket would be 4 MiB of buffers.
+			template <typename T, Index BITS = SHIFT_BITS>
+			inline Scatter getScatter(Index size, const Options& options, bool copiedBack)
+			{
+				if constexpr (!is_line_scatterable<T> || BITS > WIDE_DIGIT_BITS)
+					return Scatter::DIRECT;
+
+				if (options.scatter != Scatter::AUTO)
+					return options.scatter;
+
+				if (!copiedBack && size * sizeof(T) >= STREAMING_SCATTER_THRESHOLD_BYTES)
+					return Scatter::STREAMING;
+
+				return Scatter::DIRECT;
+			}
+
+			// tmp[prefix[getDigit(v[i])]++] = v[i] for i in [l, r) through a WriteCombiner
+			template <Index BITS = SHIFT_BITS, typename T, typename GetDigit>
+			inline void scatterBuffered(std::span<T> v, std::span<T> tmp, std::vector<Index>& prefix, Index l, Index r, Scatter scatter, GetDigit&& getDigit)
+			{
+				auto combiner = std::make_unique<WriteCombiner<T, BITS>>(tmp, prefix, scatter == Scatter::STREAMING);
+
+				for (Index i = l; i < r; i++)
+					combiner->push(getDigit(v[i]), v[i]);
+
+				combiner->finish(prefix);
+			}
+
+			// =================
+			// -----Helpers-----
+			// =================
+
+			inline Index getChar(const std::string& s, Index index)
+			{
+				return (index < s.length()) ? static_cast<unsigned char>(s[index]) : 256;
+			}
+
+			// XOR for the digit at shift of a signed key: the digit holding the sign bit gets it flipped, so negative keys order
+			// first (INVERT_MASK for the top byte), every other digit is taken as is
+			template <typename Key, Index BITS = SHIFT_BITS>
+			inline Index getSignFlip(Index shift)
+			{
+				constexpr Index KEY_BITS = sizeof(Key) * 8;
+
+				if constexpr (std::signed_integral<Key>)
+					return (shift + BITS >= KEY_BITS) ? static_cast<Index>(1) << (KEY_BITS - 1 - shift) : 0;
+				else
+					return 0;
+			}
+
+			// LSD passes over keys with len significant bytes
+			inline Index getDigitPasses(Index len, Index bits)
+			{
+				return (len * SHIFT_BITS + bits - 1) / bits;
+			}
+
+			// LSD digit width for size items holding keys with len significant bytes: options.digitBits when it names a supported
+			// width, otherwise bytes unless the passes scatter directly past the caches, where every pass saved is a full read and a
+			// scattered write of the array (WIDE_DIGIT_BITS from WIDE_DIGIT_THRESHOLD_BYTES, MAX_DIGIT_BITS from MAX_DIGIT_THRESHOLD_BYTES).
+			// Streamed byte passes beat streamed 11-bit ones on every size measured, so inputs AUTO streams keep 8-bit digits.
+			template <typename T>
+			inline Index getDigitBits(Index size, Index len, const Options& options)
+			{
+				if (options.digitBits == SHIFT_BITS || options.digitBits == WIDE_DIGIT_BITS || options.digitBits == MAX_DIGIT_BITS)
+					return options.digitBits;
+
+				const Index BYTES = size * sizeof(T);
+
+				if (BYTES < WIDE_DIGIT_THRESHOLD_BYTES || getScatter<T>(size, options, false) == Scatter::STREAMING)
+					return SHIFT_BITS;
+
+				if (BYTES >= MAX_DIGIT_THRESHOLD_BYTES && getDigitPasses(len, MAX_DIGIT_BITS) < getDigitPasses(len, WIDE_DIGIT_BITS))
+					return MAX_DIGIT_BITS;
+
+				if (getDigitPasses(len, WIDE_DIGIT_BITS) < len)
+					return WIDE_DIGIT_BITS;
+
+				return SHIFT_BITS;
+			}
+
+			inline Index getNumOfThreads(Index n, const Options& options)
+			{
+				const Index MAX_THREADS = std::min(maxConcurrency.load(std::memory_order_relaxed), MAX_HW_THREADS);
+
+				if (options.threadScaling == ThreadScaling::POWER_OF_TWO)
+				{
+					if (n < (options.multiThreadingThreshold << 1))
+						return 1;
+
+					if (options.numOfThreads)
+						return std::clamp<Index>(options.numOfThreads, 1, MAX_THREADS);
+
+					Index ratio = n / std::max<Index>(options.multiThreadingThreshold, 1);
+					Index numOfThreads = 1;
+					while ((numOfThreads << 1) <= ratio)
+						numOfThreads <<= 1;
+
+					return std::max<Index>(std::min({ numOfThreads, MAX_THREADS, options.maxSwThreads }), 1);
+				}
+				else
+				{
+					if (n < options.multiThreadingThreshold)
+						return 1;
+
+					if (options.numOfThreads)
+						return std::clamp<Index>(options.numOfThreads, 1, MAX_THREADS);
+
+					return std::clamp<Index>(n / std::max<Index>(options.minElementsPerThread, 1), 1, MAX_THREADS);
+				}
+			}
+
+			// Merges the per-thread histograms into count. Past HIERARCHICAL_MERGE_THRESHOLD threads
+			// they are reduced pairwise in log2(numOfThreads) parallel rounds instead of one serial loop, counts is clobbered.
+			inline void mergeCounts(std::vector<std::vector<Index>>& counts, std::vector<Index>& count)
+			{
+				const Index NUM_OF_COUNTS = counts.size();
+				const Index ALLOC_SIZE = count.size();
+
+				if (NUM_OF_COUNTS < HIERARCHICAL_MERGE_THRESHOLD)
+				{
+					for (Index curThread = 0; curThread < NUM_OF_COUNTS; curThread++)
+					{
+						for (Index i = 0; i < ALLOC_SIZE; i++)
+							count[i] += counts[curThread][i];
+					}
+					return;
+				}
+
+				for (Index stride = 1; stride < NUM_OF_COUNTS; stride <<= 1)
+				{
+					Index numOfPairs = (NUM_OF_COUNTS + (stride << 1) - 1) / (stride << 1);
+
+					parallelFor(numOfPairs, [&counts, stride, NUM_OF_COUNTS, ALLOC_SIZE](Index pair) {
+						Index dst = pair * (stride << 1);
+						Index src = dst + stride;
+
+						if (src < NUM_OF_COUNTS)
+						{
+							for (Index i = 0; i < ALLOC_SIZE; i++)
+								counts[dst][i] += counts[src][i];
+						}
+					});
+				}
+
+				for (Index i = 0; i < ALLOC_SIZE; i++)
+					count[i] += counts[0][i];
+			}
+
+			template <Index BITS = SHIFT_BITS, typename T>
+			inline void getCountVectorThread(std::span<T> v, std::vector<Index>& count, Index curShiftOrIndex, Index l, Index r)
+			{
+				if constexpr (is_string<T>)
+				{
+					for (const auto& str : std::span(v).subspan(l, r - l))
+						count[getChar(str, curShiftOrIndex)]++;
+				}
+				else if constexpr (std::integral<T>)
+				{
+					Index flip = getSignFlip<T, BITS>(curShiftOrIndex);
+					const T* keys = v.data() + l;
+
+					countDigit<BITS>(r - l, count.data(), [keys, curShiftOrIndex, flip](Index i) {
+						return ((static_cast<alias_unsigned<T>>(keys[i]) >> curShiftOrIndex) & DIGIT_MASK<BITS>) ^ flip;
+					});
+				}
+			}
+
+			template <typename T>
+			inline void getCountVector(std::span<T> v, MsdWorkspace& workspace, Index curShiftOrIndex, Index l, Index r, const Options& options, bool enableMultiThreading)
+			{
+				const Index SIZE = r - l;
+				Index numOfThreads = getNumOfThreads(SIZE, options);
+
+				if (!enableMultiThreading || numOfThreads <= 1)
+				{
+					getCountVectorThread(v, workspace.count, curShiftOrIndex, l, r);
+				}
+				else
+				{
+					std::vector<std::vector<Index>>& counts = workspace.getCounts(numOfThreads);
+					Index bucketSize = SIZE / numOfThreads;
+
+					parallelFor(numOfThreads, [&v, &counts, curShiftOrIndex, l, r, bucketSize, numOfThreads](Index i) {
+						Index start = l + i * bucketSize;
+						Index end = (i == numOfThreads - 1) ? r : start + bucketSize;
+						getCountVectorThread(v, counts[i], curShiftOrIndex, start, end);
+					});
+
+					mergeCounts(counts, workspace.count);
+				}
+			}
+
+			template <Index LEN, Index BITS, typename U, typename Counter, typename Range, typename GetBits>
+			inline void countDigitsInto(Range&& range, Counter* count, Counter* other, GetBits&& getBits)
+			{
+				constexpr Index DIGITS_BASE = DIGIT_BASE<BITS>;
+				constexpr Index DIGITS_MASK = DIGIT_MASK<BITS>;
+				const Index SIZE = range.size();
+
+				[&range, &getBits, count, other, SIZE]<Index... DIGITS>(std::integer_sequence<Index, DIGITS...>) {
+					Index i = 0;
+					for (; i + 2 <= SIZE; i += 2)
+					{
+						U bits = getBits(range[i]);
+						U next = getBits(range[i + 1]);
+						((count[DIGITS * DIGITS_BASE + ((bits >> (DIGITS * BITS)) & DIGITS_MASK)]++), ...);
+						((other[DIGITS * DIGITS_BASE + ((next >> (DIGITS * BITS)) & DIGITS_MASK)]++), ...);
+					}
+
+					if (i < SIZE)
+					{
+						U bits = getBits(range[i]);
+						((count[DIGITS * DIGITS_BASE + ((bits >> (DIGITS * BITS)) & DIGITS_MASK)]++), ...);
+					}
+				}(std::make_integer_sequence<Index, LEN>{});
+			}
+
+			// LEN digit histograms of BITS bits in one read, digit d at counts[d * DIGIT_BASE<BITS>], getBits(item) returns the key
+			// bits in sort order. The digits are expanded at compile time, a runtime digit loop is not unrolled and costs as much as
+			// separate reads. Ranges that fit 32-bit counters are counted into those and added to counts afterwards.
+			template <Index LEN, Index BITS, typename U, typename Range, typename GetBits>
+			inline void countDigits(Range&& range, std::vector<Index>& counts, GetBits&& getBits)
+			{
+				if constexpr ((LEN - 1) * BITS < sizeof(U) * 8)
+				{
+					constexpr Index HISTOGRAM_SIZE = LEN * DIGIT_BASE<BITS>;
+
+					// neighbouring keys alternate between two sets of histograms, so equal digits do not serialize on one counter
+					if (range.size() <= SMALL_INDEX_LIMIT)
+					{
+						std::vector<SmallIndex> small(2 * HISTOGRAM_SIZE);
+						countDigitsInto<LEN, BITS, U>(range, small.data(), small.data() + HISTOGRAM_SIZE, getBits);
+
+						for (Index i = 0; i < HISTOGRAM_SIZE; i++)
+							counts[i] += static_cast<Index>(small[i]) + small[HISTOGRAM_SIZE + i];
+					}
+					else
+					{
+						std::vector<Index> second(HISTOGRAM_SIZE);
+						countDigitsInto<LEN, BITS, U>(range, counts.data(), second.data(), getBits);
+
+						for (Index i = 0; i < HISTOGRAM_SIZE; i++)
+							counts[i] += second[i];
+					}
+				}
+			}
+
+			template <Index BITS, typename U, typename Range, typename GetBits>
+			inline void countDigits(Range&& range, std::vector<Index>& counts, Index passes, GetBits&& getBits)
+			{
+				switch (passes)
+				{
+					case 1: countDigits<1, BITS, U>(range, counts, getBits); break;
+					case 2: countDigits<2, BITS, U>(range, counts, getBits); break;
+					case 3: countDigits<3, BITS, U>(range, counts, getBits); break;
+					case 4: countDigits<4, BITS, U>(range, counts, getBits); break;
+					case 5: countDigits<5, BITS, U>(range, counts, getBits); break;
+					case 6: countDigits<6, BITS, U>(range, counts, getBits); break;
+					case 7: countDigits<7, BITS, U>(range, counts, getBits); break;
+					case 8: countDigits<8, BITS, U>(range, counts, getBits); break;
+				}
+			}
+
+			// all LSD digit histograms of [l, r) in one read, digit d at counts[d * DIGIT_BASE<BITS>]
+			template <Index BITS = SHIFT_BITS, typename T>
+			inline void getCountVectorsThread(std::span<T> v, std::vector<Index>& counts, Index passes, Index l, Index r)
+			{
+				using U = t2u<T>;
+
+				countDigits<BITS, U>(std::span(v).subspan(l, r - l), counts, passes, [](const T& num) {
+					if constexpr (std::signed_integral<T>)
+						return static_cast<U>(static_cast<U>(num) ^ (static_cast<U>(INVERT_MASK) << ((sizeof(T) - 1) * 8)));
+					else
+						return static_cast<U>(num);
+				});
+			}
+
+			// Digit histograms for an LSD sort of size keys from one read: chunkCounts per chunk of the parallelScatter split
+			// (one chunk when serial), counts summed over chunks. countChunk(chunkCounts, start, end) fills one chunk.
+			template <Index BITS = SHIFT_BITS, typename CountFunc>
+			inline void getDigitCounts(std::vector<Index>& counts, std::vector<std::vector<Index>>& chunkCounts,
+				Index size, Index passes, Index numOfThreads, CountFunc&& countChunk)
+			{
+				chunkCounts.assign(numOfThreads, std::vector<Index>(passes * DIGIT_BASE<BITS>));
+				counts.assign(passes * DIGIT_BASE<BITS>, 0);
+
+				if (numOfThreads <= 1)
+					countChunk(chunkCounts[0], 0, size);
+				else
+				{
+					Index bucketSize = size / numOfThreads;
+					parallelFor(numOfThreads, [&countChunk, &chunkCounts, size, bucketSize, numOfThreads](Index i) {
+						Index start = i * bucketSize;
+						Index end = (i == numOfThreads - 1) ? size : start + bucketSize;
+						countChunk(chunkCounts[i], start, end);
+					});
+				}
+
+				for (const auto& chunkCount : chunkCounts)
+				{
+					for (Index i = 0, n = counts.size(); i < n; i++)
+						counts[i] += chunkCount[i];
+				}
+			}
+
+			// one digit's slice of every chunk histogram, in the layout parallelScatter takes
+			template <Index BITS = SHIFT_BITS>
+			inline std::vector<std::vector<Index>> getDigitChunkCounts(std::vector<std::vector<Index>>& chunkCounts, Index digit)
+			{
+				std::vector<std::vector<Index>> counts;
+				counts.reserve(chunkCounts.size());
+
+				for (const auto& chunkCount : chunkCounts)
+					counts.emplace_back(chunkCount.begin() + digit * DIGIT_BASE<BITS>, chunkCount.begin() + (digit + 1) * DIGIT_BASE<BITS>);
+
+				return counts;
+			}
+
+			// a pass over a digit every key shares would only copy the input
+			template <Index BITS = SHIFT_BITS>
+			inline bool isTrivialDigit(std::vector<Index>& counts, Index digit, Index size)
+			{
+				auto first = counts.begin() + digit * DIGIT_BASE<BITS>;
+				return std::find(first, first + DIGIT_BASE<BITS>, size) != first + DIGIT_BASE<BITS>;
+			}
+
+			template <typename T, Index BITS = SHIFT_BITS>
+			inline void getPrefixVector(std::vector<Index>& prefix, std::vector<Index>& count, Index l)
+			{
+				if constexpr (is_string<T>)
+				{
+					prefix[256] = l;
+					prefix[0] = prefix[256] + count[256];
+				}
+				else
+				{
+					prefix[0] = l;
+				}
+
+				for (Index i = 1; i < DIGIT_BASE<BITS>; i++)
+					prefix[i] = prefix[i - 1] + count[i - 1];
+			}
+
+			template <typename T>
+			inline void partitionRegions(std::vector<Index>& count, std::vector<Region>& regionsLocal,
+				RegionScheduler& scheduler, Index workerIndex,
+				Index len, Index curShiftOrIndex, Index l, bool inTmp, const Options& options, bool enableMultiThreading)
+			{
+				Index start = 0;
+				if constexpr (is_string<T>)
+				{
+					start = l + count[256];
+					curShiftOrIndex++;
+				}
+				else
+				{
+					start = l;
+					curShiftOrIndex -= SHIFT_BITS;
+				}
+
+				if (!enableMultiThreading)
+				{
+					for (Index i = 0; i < BASE; i++)
+					{
+						if (count[i] > 1)
+							regionsLocal.emplace_back(start, start + count[i], len, curShiftOrIndex, inTmp);
+						start += count[i];
+					}
+				}
+				else
+				{
+					for (Index i = 0; i < BASE; i++)
+					{
+						if (count[i] > 1)
+						{
+							if (count[i] < options.globalBucketThreshold)
+								regionsLocal.emplace_back(start, start + count[i], len, curShiftOrIndex, inTmp);
+							else
+								scheduler.publish(workerIndex, Region(start, start + count[i], len, curShiftOrIndex, inTmp));
+						}
+						start += count[i];
+					}
+				}
+			}
+
+			// After a level scattered [l, l + sum(count)) into tmp, the buckets that are not sorted any further
+			// (single items and, for strings, the ones that ended) are final and moveBack(start, end) returns them to v.
+			template <typename T, typename MoveFunc>
+			inline void moveBackSettled(std::vector<Index>& count, Index l, MoveFunc&& moveBack)
+			{
+				Index start = l;
+				if constexpr (is_string<T>)
+				{
+					moveBack(start, start + count[256]);
+					start += count[256];
+				}
+
+				for (Index i = 0; i < BASE; i++)
+				{
+					if (count[i] == 1)
+						moveBack(start, start + 1);
+					start += count[i];
+				}
+			}
+
+			// Stable parallel counting pass over [l, r) from per-chunk histograms (counts[i] belongs to chunk i of the split below):
+			// chunk write offsets are derived from those, then every chunk scatters its own slice.
+			// scatterChunk(chunkPrefix, start, end), count receives the merged histogram.
+			template <typename T, Index BITS = SHIFT_BITS, typename ScatterFunc>
+			inline void parallelScatter(std::vector<Index>& count, std::vector<std::vector<Index>>& counts, Index l, Index r, Index numOfThreads, ScatterFunc&& scatterChunk)
+			{
+				constexpr Index ALLOC_SIZE = (is_string<T>) ? CHARS_ALLOC : DIGIT_BASE<BITS>;
+
+				const Index SIZE = r - l;
+				Index bucketSize = SIZE / numOfThreads;
+
+				// the per-chunk histograms are needed for the offsets, so past HIERARCHICAL_MERGE_THRESHOLD
+				// the totals and offsets are computed in parallel over slices of buckets instead of reducing counts in place
+				Index numOfSlices = (numOfThreads < HIERARCHICAL_MERGE_THRESHOLD) ? 1 : std::min(numOfThreads, ALLOC_SIZE);
+				Index sliceSize = ALLOC_SIZE / numOfSlices;
+
+				auto forEachSlice = [numOfSlices, sliceSize](auto&& func) {
+					parallelFor(numOfSlices, [&func, numOfSlices, sliceSize](Index slice) {
+						Index start = slice * sliceSize;
+						Index end = (slice == numOfSlices - 1) ? ALLOC_SIZE : start + sliceSize;
+						func(start, end);
+					});
+				};
+
+				forEachSlice([&count, &counts, numOfThreads](Index start, Index end) {
+					for (Index curThread = 0; curThread < numOfThreads; curThread++)
+					{
+						for (Index i = start; i < end; i++)
+							count[i] += counts[curThread][i];
+					}
+				});
+
+				std::vector<Index> prefix(ALLOC_SIZE);
+				getPrefixVector<T, BITS>(prefix, count, l);
+
+				forEachSlice([&prefix, &counts, numOfThreads](Index start, Index end) {
+					for (Index i = start; i < end; i++)
+					{
+						Index offset = prefix[i];
+						for (Index curThread = 0; curThread < numOfThreads; curThread++)
+						{
+							Index chunkCount = counts[curThread][i];
+							counts[curThread][i] = offset;
+							offset += chunkCount;
+						}
+					}
+				});
+
+				parallelFor(numOfThreads, [&scatterChunk, &counts, l, r, bucketSize, numOfThreads](Index i) {
+					Index start = l + i * bucketSize;
+					Index end = (i == numOfThreads - 1) ? r : start + bucketSize;
+					scatterChunk(counts[i], start, end);
+				});
+			}
+
+			// parallelScatter that first builds the chunk histograms with countChunk(chunkCount, start, end)
+			template <typename T, Index BITS = SHIFT_BITS, typename CountFunc, typename ScatterFunc>
+			inline void parallelScatter(std::vector<Index>& count, Index l, Index r, Index numOfThreads, CountFunc&& countChunk, ScatterFunc&& scatterChunk)
+			{
+				constexpr Index ALLOC_SIZE = (is_string<T>) ? CHARS_ALLOC : DIGIT_BASE<BITS>;
+
+				const Index SIZE = r - l;
+				Index bucketSize = SIZE / numOfThreads;
+				std::vector<std::vector<Index>> counts(numOfThreads, std::vector<Index>(ALLOC_SIZE));
+
+				parallelFor(numOfThreads, [&countChunk, &counts, l, r, bucketSize, numOfThreads](Index i) {
+					Index start = l + i * bucketSize;
+					Index end = (i == numOfThreads - 1) ? r : start + bucketSize;
+					countChunk(counts[i], start, end);
+				});
+
+				parallelScatter<T, BITS>(count, counts, l, r, numOfThreads, scatterChunk);
+			}
+
+			// Runs the MSD levels whose regions are above options.parallelScatterThreshold with parallelScatter before the workers start,
+			// the remaining regions are spread over the worker deques, largest at the top so thieves take them first.
+			// countChunk receives (chunkCount, curShiftOrIndex, inTmp, start, end) and reads from tmp when inTmp is set, scatterChunk
+			// receives (chunkPrefix, curShiftOrIndex, inTmp, construct, start, end) and scatters into the other array, constructing
+			// its slots when construct is set (the first level into a raw tmp). moveBack(start, end) copies tmp into v.
+			// Returns whether tmp is still raw, i.e. the top level was left to the workers.
+			template <typename T, typename CountFunc, typename ScatterFunc, typename MoveFunc>
+			inline bool partitionTopLevels(RegionScheduler& scheduler, Index numOfWorkers, Region initialRegion, bool isTmpRaw, const Options& options,
+				CountFunc&& countChunk, ScatterFunc&& scatterChunk, MoveFunc&& moveBack)
+			{
+				constexpr Index ALLOC_SIZE = (is_string<T>) ? CHARS_ALLOC : BASE;
+
+				std::vector<Region> regionsLarge;
+				std::vector<Region> regionsSeed;
+				regionsLarge.emplace_back(initialRegion);
+
+				while (regionsLarge.size())
+				{
+					Region region = regionsLarge.back();
+					regionsLarge.pop_back();
+
+					Index l = region.l;
+					Index r = region.r;
+					Index len = region.len;
+					Index curShiftOrIndex = region.curShiftOrIndex;
+					Index numOfThreads = getNumOfThreads(r - l, options);
+
+					bool isDeep = false;
+					if constexpr (is_string<T>)
+						isDeep = curShiftOrIndex >= options.stringMsdMaxDepth;
+
+					if (len == 0 || isDeep || r - l < options.parallelScatterThreshold || numOfThreads <= 1)
+					{
+						regionsSeed.emplace_back(region);
+						continue;
+					}
+
+					std::vector<Index> count(ALLOC_SIZE);
+
+					bool inTmp = region.inTmp;
+					bool construct = isTmpRaw;
+
+					parallelScatter<T>(count, l, r, numOfThreads,
+						[&countChunk, curShiftOrIndex, inTmp](std::vector<Index>& chunkCount, Index start, Index end) {
+							countChunk(chunkCount, curShiftOrIndex, inTmp, start, end);
+						},
+						[&scatterChunk, curShiftOrIndex, inTmp, construct](std::vector<Index>& chunkPrefix, Index start, Index end) {
+							scatterChunk(chunkPrefix, curShiftOrIndex, inTmp, construct, start, end);
+						});
+
+					isTmpRaw = false;
+
+					// the items are now in the other array, only the ones left in tmp for good are copied back
+					len--;
+					if (len == 0)
+					{
+						if (!inTmp)
+						{
+							Index bucketSize = (r - l) / numOfThreads;
+							parallelFor(numOfThreads, [&moveBack, l, r, bucketSize, numOfThreads](Index i) {
+								Index start = l + i * bucketSize;
+								Index end = (i == numOfThreads - 1) ? r : start + bucketSize;
+								moveBack(start, end);
+							});
+						}
+						continue;
+					}
+
+					if (!inTmp)
+						moveBackSettled<T>(count, l, moveBack);
+
+					std::vector<Region> children;
+					partitionRegions<T>(count, children, scheduler, 0, len, curShiftOrIndex, l, !inTmp, options, false);
+
+					for (const auto& child : children)
+					{
+						if (child.r - child.l >= options.parallelScatterThreshold)
+							regionsLarge.emplace_back(child);
+						else
+							regionsSeed.emplace_back(child);
+					}
+				}
+
+				std::sort(regionsSeed.begin(), regionsSeed.end(), [](const Region& a, const Region& b) {
+					return a.r - a.l > b.r - b.l;
+				});
+
+				for (Index i = 0, size = regionsSeed.size(); i < size; i++)
+					scheduler.publish(i % numOfWorkers, regionsSeed[i]);
+
+				return isTmpRaw;
+			}
+
+			// ============================
+			// -----Strategy Selection-----
+			// ============================
+
+			inline void setReport(const Options& options, Report report)
+			{
+				if (options.report)
+					*options.report = std::move(report);
+			}
+
+			// key bits in sort order: signed keys get their sign bit flipped, floating point keys are inverted when negative
+			// and get their sign bit set otherwise (IEEE-754 totalOrder, like getUnsignedVector maps them)
+			template <typename Key>
+			inline t2u<Key> getOrderedBits(const Key& key)
+			{
+				using U = t2u<Key>;
+				constexpr U SIGN_BIT = static_cast<U>(1) << (sizeof(Key) * 8 - 1);
+
+				if constexpr (is_floating_point<Key>)
+				{
+					U bits = std::bit_cast<U>(key);
+					return (bits & SIGN_BIT) ? static_cast<U>(~bits) : static_cast<U>(bits ^ SIGN_BIT);
+				}
+				else if constexpr (std::signed_integral<Key>)
+					return static_cast<U>(key) ^ SIGN_BIT;
+				else
+					return static_cast<U>(key);
+			}
+
+			// integral key back from its getOrderedBits
+			template <std::integral Key>
+			inline Key fromOrderedBits(t2u<Key> bits)
+			{
+				using U = t2u<Key>;
+				constexpr U SIGN_BIT = static_cast<U>(1) << (sizeof(Key) * 8 - 1);
+
+				if constexpr (std::signed_integral<Key>)
+					return static_cast<Key>(static_cast<U>(bits ^ SIGN_BIT));
+				else
+					return static_cast<Key>(bits);
+			}
+
+			inline std::string getPercent(double fraction)
+			{
+				return std::to_string(static_cast<Index>(fraction * 100.0 + 0.5)) + "%";
+			}
+
+			// Picks LSD, MSD, counting sort or the comparison fallback for size keys read through getKey(i),
+			// len being the number of significant key bytes. Strings and small inputs keep the type based rule,
+			// larger inputs are judged on SAMPLE_SIZE evenly spaced keys:
+			// - a narrow sampled range is confirmed with a full pass and sorted with one counting pass,
+			// - an (almost) fully ordered or reversed sample goes to the comparison sort, a mostly ordered one to MSD,
+			//   whose scatters then stay close to sequential,
+			// - otherwise the per-byte entropy estimates how many MSD levels it takes to reach insertion-sized buckets,
+			//   MSD wins when those levels cost less than the LSD passes over len bytes.
+			// IS_VALUE marks keys that are the values themselves: counting sort rebuilds them from the histogram without scratch,
+			// so it is also taken for small integrals and for inputs too small to sample, once the exact range fits.
+			template <typename Key, bool IS_VALUE = false, typename GetKey>
+			inline Report selectStrategy(Index size, Index len, const Options& options, GetKey&& getKey)
+			{
+				Report report;
+				Index numOfThreads = getNumOfThreads(size, options);
+				bool isParallel = options.enableMultiThreading && numOfThreads > 1;
+
+				report.keyLength = len;
+				report.numOfThreads = (isParallel) ? numOfThreads : 1;
+
+				auto selectByType = [&report, len, isParallel](std::string reason) {
+					if (is_string<Key> || (is_large_integral<Key> && len > 1))
+						report.strategy = Strategy::MSD;
+					else if (is_small_integral<Key> || len <= 1 || !isParallel)
+						report.strategy = Strategy::LSD;
+					else
+						report.strategy = Strategy::MSD;
+
+					report.reason = std::move(reason);
+				};
+
+				if (options.strategy == Strategy::LSD && !is_string<Key>)
+				{
+					report.strategy = Strategy::LSD;
+					report.reason = "forced by options";
+					return report;
+				}
+				else if (options.strategy == Strategy::MSD)
+				{
+					report.strategy = Strategy::MSD;
+					report.reason = "forced by options";
+					return report;
+				}
+
+				if constexpr (is_string<Key>)
+				{
+					selectByType("string keys are sorted with MSD");
+					return report;
+				}
+				else
+				{
+					using U = t2u<Key>;
+
+					// ranges are only worth a histogram when it is no larger than the input and wider than one LSD pass
+					auto tryCounting = [&report, &getKey, size]() {
+						U minKey = std::numeric_limits<U>::max();
+						U maxKey = 0;
+
+						for (Index i = 0; i < size; i++)
+						{
+							U key = getOrderedBits(getKey(i));
+							minKey = std::min(minKey, key);
+							maxKey = std::max(maxKey, key);
+						}
+
+						report.minKey = minKey;
+						report.keyRange = (static_cast<Index>(maxKey - minKey) < COUNTING_SORT_MAX_RANGE) ? static_cast<Index>(maxKey - minKey) + 1 : 0;
+
+						return report.keyRange && report.keyRange <= size;
+					};
+
+					if (options.strategy == Strategy::COUNTING)
+					{
+						if ((IS_VALUE || !is_small_integral<Key>) && tryCounting())
+						{
+							report.strategy = Strategy::COUNTING;
+							report.reason = "forced by options";
+						}
+						else
+							selectByType("forced counting sort, but the key range does not fit " + std::to_string(std::min(size, COUNTING_SORT_MAX_RANGE)) + " buckets");
+
+						return report;
+					}
+
+					if constexpr (IS_VALUE)
+					{
+						if ((is_small_integral<Key> || size < SAMPLING_THRESHOLD) && tryCounting())
+						{
+							report.strategy = Strategy::COUNTING;
+							report.reason = "values rebuilt from a histogram of " + std::to_string(report.keyRange) + " key values";
+							return report;
+						}
+					}
+
+					if (size < SAMPLING_THRESHOLD)
+					{
+						selectByType("too small to sample, chosen by key type");
+						return report;
+					}
+
+					const Index NUM_OF_SAMPLES = std::min(size, SAMPLE_SIZE);
+					const Index STRIDE = size / NUM_OF_SAMPLES;
+
+					std::vector<U> samples(NUM_OF_SAMPLES);
+					for (Index i = 0; i < NUM_OF_SAMPLES; i++)
+						samples[i] = getOrderedBits(getKey(i * STRIDE));
+
+					Index inOrder = 0;
+					for (Index i = 1; i < NUM_OF_SAMPLES; i++)
+						inOrder += samples[i - 1] <= samples[i];
+
+					for (Index byte = 0; byte < sizeof(Key); byte++)
+					{
+						std::array<Index, BASE> count = {};
+						for (const auto& sample : samples)
+							count[(sample >> (byte * SHIFT_BITS)) & MASK]++;
+
+						double entropy = 0.0;
+						for (const auto& c : count)
+						{
+							if (c)
+							{
+								double p = static_cast<double>(c) / NUM_OF_SAMPLES;
+								entropy -= p * std::log2(p);
+							}
+						}
+						report.entropy[byte] = entropy;
+					}
+
+					std::sort(samples.begin(), samples.end());
+					report.sampleSize = NUM_OF_SAMPLES;
+					report.distinctKeys = std::unique(samples.begin(), samples.end()) - samples.begin();
+					report.presortedness = static_cast<double>(inOrder) / (NUM_OF_SAMPLES - 1);
+
+					if (!is_small_integral<Key> && static_cast<Index>(samples[report.distinctKeys - 1] - samples[0]) < COUNTING_SORT_MAX_RANGE && tryCounting())
+					{
+						report.strategy = Strategy::COUNTING;
+						report.reason = (IS_VALUE) ? "values rebuilt from a histogram of " + std::to_string(report.keyRange) + " key values"
+							: std::to_string(report.keyRange) + " distinct key values fit one counting pass";
+						return report;
+					}
+
+					if (report.presortedness >= PRESORTED_THRESHOLD || report.presortedness <= 1.0 - PRESORTED_THRESHOLD)
+					{
+						report.strategy = Strategy::COMPARISON;
+						report.reason = "sample is " + getPercent(std::max(report.presortedness, 1.0 - report.presortedness)) + " ordered";
+						return report;
+					}
+
+					if (report.presortedness >= PRESORTED_MSD_THRESHOLD || report.presortedness <= 1.0 - PRESORTED_MSD_THRESHOLD)
+					{
+						report.strategy = Strategy::MSD;
+						report.reason = "sample is " + getPercent(std::max(report.presortedness, 1.0 - report.presortedness)) + " ordered, MSD scatters stay close to sequential";
+						return report;
+					}
+
+					// bits MSD has to resolve before buckets drop to insertion sort size, duplicates cap what the keys can provide
+					double requiredBits = std::log2(static_cast<double>(size) / std::max<Index>(options.insertionSortThresholdAll, 1));
+					bool isCapped = report.distinctKeys < NUM_OF_SAMPLES && std::log2(static_cast<double>(report.distinctKeys)) < requiredBits;
+
+					Index msdPasses = 0;
+					double bits = 0.0;
+					for (Index byte = len; byte-- > 0 && (isCapped || bits < requiredBits); )
+					{
+						bits += report.entropy[byte];
+						msdPasses++;
+					}
+
+					// wide digits cut the LSD passes on large directly scattered arrays, the array is approximated by its keys
+					Index lsdPasses = getDigitPasses(len, getDigitBits<Key>(size, len, options));
+					double msdCost = msdPasses * MSD_PASS_COST;
+					std::string estimate = std::to_string(msdPasses) + " MSD levels vs " + std::to_string(lsdPasses) + " LSD passes";
+
+					if (msdCost < lsdPasses)
+					{
+						report.strategy = Strategy::MSD;
+						report.reason = "high entropy in the top bytes, " + estimate;
+					}
+					else if (msdCost > lsdPasses)
+					{
+						report.strategy = Strategy::LSD;
+						report.reason = ((isCapped) ? "few distinct keys, " : "low entropy in the top bytes, ") + estimate;
+					}
+					else
+						selectByType("no clear winner (" + estimate + "), chosen by key type");
+
+					return report;
+				}
+			}
+
+			// selectStrategy behind options.plan: its decision is replayed while the size class and key length match
+			// (and, for counting sort, the exact key range still fits), otherwise a new one is made and recorded.
+			template <typename Key, bool IS_VALUE = false, typename GetKey>
+			inline Report planStrategy(Index size, Index len, const Options& options, GetKey&& getKey)
+			{
+				if (!options.plan || options.strategy != Strategy::AUTO)
+					return selectStrategy<Key, IS_VALUE>(size, len, options, getKey);
+
+				Plan& plan = *options.plan;
+
+				if (plan.covers(size) && plan.decision.keyLength == len)
+				{
+					Report report = plan.decision;
+
+					if (report.strategy == Strategy::COUNTING)
+					{
+						Options replay = options;
+						replay.strategy = Strategy::COUNTING;
+
+						Report counting = selectStrategy<Key, IS_VALUE>(size, len, replay, getKey);
+						report.minKey = counting.minKey;
+						report.keyRange = counting.keyRange;
+
+						if (counting.strategy == Strategy::COUNTING)
+						{
+							report.reason = "replayed from plan: " + plan.decision.reason;
+							return report;
+						}
+					}
+					else
+					{
+						report.numOfThreads = (options.enableMultiThreading) ? getNumOfThreads(size, options) : 1;
+						report.reason = "replayed from plan: " + plan.decision.reason;
+						return report;
+					}
+				}
+
+				Report report = selectStrategy<Key, IS_VALUE>(size, len, options, getKey);
+				plan.decision = report;
+				plan.sizeClass = std::bit_width(size);
+
+				return report;
+			}
+
+			// =========================
+			// -----In-Place Engine-----
+			// =========================
+
+			// insertion sort of [l, r) on getBits(item), stable
+			template <typename T, typename GetBits>
+			inline void insertionSortBits(std::span<T> v, Index l, Index r, GetBits& getBits)
+			{
+				for (Index i = l + 1; i < r; i++)
+				{
+					T item = std::move(v[i]);
+					const auto BITS = getBits(item);
+					Index j = i;
+
+					while (j > l && BITS < getBits(v[j - 1]))
+					{
+						v[j] = std::move(v[j - 1]);
+						j--;
+					}
+
+					v[j] = std::move(item);
+				}
+			}
+
+			// Unstable MSD radix sort without a second array (American flag sort), getBits(item) returning the key bits in sort
+			// order. Every level counts its region, then walks the permutation cycles: an item out of place is swapped into the
+			// next free slot of its bucket until an item of the current bucket comes back. Besides v it only takes BASE counters
+			// per level and the region stack.
+			template <typename T, typename GetBits>
+			inline void sortInPlaceMsd(std::span<T> v, Index len, const Options& options, GetBits&& getBits)
+			{
+				if (len == 0)
+					return;
+
+				std::vector<Region> regions;
+				regions.emplace_back(0, v.size(), len, (len - 1) * SHIFT_BITS);
+
+				std::array<Index, BASE> count;
+				std::array<Index, BASE> next;
+				std::array<Index, BASE> end;
+
+				while (!regions.empty())
+				{
+					const Region region = regions.back();
+					regions.pop_back();
+
+					const Index l = region.l;
+					const Index r = region.r;
+					const Index shift = region.curShiftOrIndex;
+
+					if (r - l <= options.insertionSortThresholdAll)
+					{
+						insertionSortBits(v, l, r, getBits);
+						continue;
+					}
+
+					auto getDigit = [&getBits, shift](const T& item) {
+						return static_cast<Index>((getBits(item) >> shift) & MASK);
+					};
+
+					count.fill(0);
+					countDigit(r - l, count.data(), [&v, &getDigit, l](Index i) {
+						return getDigit(v[l + i]);
+					});
+
+					for (Index b = 0, sum = l; b < BASE; b++)
+					{
+						next[b] = sum;
+						sum += count[b];
+						end[b] = sum;
+					}
+
+					// a region in one bucket is already in place
+					if (count[getDigit(v[l])] != r - l)
+					{
+						for (Index b = 0; b < BASE; b++)
+						{
+							while (next[b] < end[b])
+							{
+								Index digit = getDigit(v[next[b]]);
+								if (digit == b)
+								{
+									next[b]++;
+									continue;
+								}
+
+								T item = std::move(v[next[b]]);
+
+								do
+								{
+									std::swap(item, v[next[digit]++]);
+									digit = getDigit(item);
+								} while (digit != b);
+
+								v[next[b]++] = std::move(item);
+							}
+						}
+					}
+
+					if (shift == 0)
+						continue;
+
+					// pushed from the top, so the buckets are sorted from the lowest up
+					for (Index b = BASE; b-- > 0; )
+					{
+						if (count[b] > 1)
+							regions.emplace_back(end[b] - count[b], end[b], region.len, shift - SHIFT_BITS);
+					}
+				}
+			}
+
+			// Block stripe of the parallel in-place engine: its item range, the bucket of every full block it flushed (in order)
+			// and one partially filled block buffer per bucket.
+			template <typename T>
+			struct InPlaceStripe
 			{
+				Index begin = 0;
+				Index end = 0;
+				std::vector<std::uint8_t> blocks;
+				std::vector<T> buffer;
+				std::array<Index, BASE> fill = {};
+			};
+
+			// One parallel in-place MSD level over v (IPS2Ra style), getDigit(item) giving the bucket, BLOCK items per block:
+			// 1. every stripe of the block grid classifies its items into one block buffer per bucket, a full buffer is flushed
+			//    to the front of the stripe (never past what the stripe has read),
+			// 2. bucket b owns the grid slots from the first one starting inside it, its full blocks are moved there along the
+			//    chains and cycles of the block permutation (chains end in an emptied or unused slot, a cycle takes one buffer),
+			// 3. each bucket's last block can spill past its end, the spills are saved, then they and the partial buffers fill
+			//    the gaps left at the bucket borders.
+			// Extra memory is a block per bucket per stripe and a few words per block. Returns the bucket sizes.
+			template <typename T, typename GetDigit>
+			inline std::array<Index, BASE> partitionInPlace(std::span<T> v, Index numOfStripes, GetDigit& getDigit)
+			{
+				constexpr Index BLOCK = std::max<Index>(IN_PLACE_BLOCK_BYTES / sizeof(T), 1);
+				constexpr Index NONE = std::numeric_limits<Index>::max();
+
 				const Index SIZE = v.size();
-				Index numOfThreads = getNumOfThreads(SIZE);
+				const Index NUM_OF_SLOTS = (SIZE + BLOCK - 1) / BLOCK;
+				numOfStripes = std::clamp<Index>(numOfStripes, 1, NUM_OF_SLOTS);
+				const Index SLOTS_PER_STRIPE = (NUM_OF_SLOTS + numOfStripes - 1) / numOfStripes;
 
-				if (!enableMultiThreading || numOfThreads <= 1)
+				std::vector<InPlaceStripe<T>> stripes(numOfStripes);
+
+				parallelFor(numOfStripes, [&v, &stripes, &getDigit, SIZE, SLOTS_PER_STRIPE](Index s) {
+					InPlaceStripe<T>& stripe = stripes[s];
+					stripe.begin = std::min(s * SLOTS_PER_STRIPE * BLOCK, SIZE);
+					stripe.end = std::min(stripe.begin + SLOTS_PER_STRIPE * BLOCK, SIZE);
+					stripe.blocks.reserve((stripe.end - stripe.begin) / BLOCK);
+					stripe.buffer.resize(BASE * BLOCK);
+
+					Index write = stripe.begin;
+
+					for (Index i = stripe.begin; i < stripe.end; i++)
+					{
+						Index digit = getDigit(v[i]);
+						stripe.buffer[digit * BLOCK + stripe.fill[digit]++] = v[i];
+
+						if (stripe.fill[digit] == BLOCK)
+						{
+							std::copy_n(stripe.buffer.begin() + digit * BLOCK, BLOCK, v.begin() + write);
+							write += BLOCK;
+							stripe.fill[digit] = 0;
+							stripe.blocks.push_back(static_cast<std::uint8_t>(digit));
+						}
+					}
+				});
+
+				std::array<Index, BASE> count = {};
+				std::array<Index, BASE> fullBlocks = {};
+
+				for (const auto& stripe : stripes)
+				{
+					for (const auto& digit : stripe.blocks)
+						fullBlocks[digit]++;
+					for (Index b = 0; b < BASE; b++)
+						count[b] += stripe.fill[b];
+				}
+
+				std::array<Index, BASE + 1> start = {};
+				std::array<Index, BASE> firstSlot = {};
+
+				for (Index b = 0; b < BASE; b++)
+				{
+					count[b] += fullBlocks[b] * BLOCK;
+					start[b + 1] = start[b] + count[b];
+					firstSlot[b] = (start[b] + BLOCK - 1) / BLOCK;
+				}
+
+				// destination slot of every flushed block, a bucket's blocks take its slots in stripe order
+				std::vector<Index> dest(NUM_OF_SLOTS, NONE);
+				std::vector<char> isTarget(NUM_OF_SLOTS, false);
+				std::array<Index, BASE> nextSlot = firstSlot;
+
+				for (const auto& stripe : stripes)
+				{
+					Index slot = stripe.begin / BLOCK;
+					for (const auto& digit : stripe.blocks)
+					{
+						dest[slot] = nextSlot[digit]++;
+						isTarget[dest[slot]] = true;
+						slot++;
+					}
+				}
+
+				// chains start at a flushed block no other block moves into and end in a slot no block is taken from,
+				// the rest of the moved blocks form cycles; chain c is slots[chainBegin[c], chainBegin[c + 1])
+				std::vector<Index> slots;
+				std::vector<Index> chainBegin;
+				std::vector<char> isCycle;
+				std::vector<char> visited(NUM_OF_SLOTS, false);
+				slots.reserve(NUM_OF_SLOTS);
+
+				for (Index slot = 0; slot < NUM_OF_SLOTS; slot++)
+				{
+					if (dest[slot] == slot)
+						visited[slot] = true;
+					else if (dest[slot] != NONE && !isTarget[slot])
+					{
+						chainBegin.push_back(slots.size());
+						isCycle.push_back(false);
+
+						for (Index cur = slot; cur != NONE; cur = dest[cur])
+						{
+							visited[cur] = true;
+							slots.push_back(cur);
+						}
+					}
+				}
+
+				for (Index slot = 0; slot < NUM_OF_SLOTS; slot++)
+				{
+					if (dest[slot] != NONE && !visited[slot])
+					{
+						chainBegin.push_back(slots.size());
+						isCycle.push_back(true);
+
+						for (Index cur = slot; !visited[cur]; cur = dest[cur])
+						{
+							visited[cur] = true;
+							slots.push_back(cur);
+						}
+					}
+				}
+
+				const Index NUM_OF_CHAINS = chainBegin.size();
+				chainBegin.push_back(slots.size());
+
+				// the grid's last slot may end past v, what lands there goes to overflow
+				std::vector<T> overflow(BLOCK);
+				auto storeBlock = [&v, &overflow, SIZE](const T* block, Index slot) {
+					const Index BEGIN = slot * BLOCK;
+					const Index INSIDE = (SIZE - BEGIN < BLOCK) ? SIZE - BEGIN : BLOCK;
+					std::copy_n(block, INSIDE, v.begin() + BEGIN);
+					std::copy_n(block + INSIDE, BLOCK - INSIDE, overflow.begin());
+				};
+
+				std::atomic<Index> nextChain = 0;
+				ThreadPool::instance().run(numOfStripes, [&v, &slots, &chainBegin, &isCycle, &nextChain, &storeBlock, NUM_OF_CHAINS](Index, Index) {
+					std::vector<T> saved;
+
+					for (Index c = nextChain.fetch_add(1, std::memory_order_relaxed); c < NUM_OF_CHAINS; c = nextChain.fetch_add(1, std::memory_order_relaxed))
+					{
+						const Index* chain = slots.data() + chainBegin[c];
+						const Index LENGTH = chainBegin[c + 1] - chainBegin[c];
+
+						// a cycle's last block moves into its first slot, a chain's last slot is free
+						if (isCycle[c])
+						{
+							saved.resize(BLOCK);
+							std::copy_n(v.begin() + chain[LENGTH - 1] * BLOCK, BLOCK, saved.begin());
+						}
+
+						for (Index j = LENGTH - 1; j > 0; j--)
+							storeBlock(v.data() + chain[j - 1] * BLOCK, chain[j]);
+
+						if (isCycle[c])
+							storeBlock(saved.data(), chain[0]);
+					}
+				});
+
+				// the part of a bucket's last block past its end, it sits in the next bucket's head gap (or in overflow)
+				std::vector<T> spills(BASE * BLOCK);
+				std::array<Index, BASE> spillCount = {};
+
+				parallelFor(BASE, [&v, &overflow, &spills, &spillCount, &start, &firstSlot, &fullBlocks, SIZE](Index b) {
+					const Index LAST_END = (firstSlot[b] + fullBlocks[b]) * BLOCK;
+
+					if (fullBlocks[b] == 0 || LAST_END <= start[b + 1])
+						return;
+
+					for (Index i = start[b + 1]; i < LAST_END; i++)
+						spills[b * BLOCK + spillCount[b]++] = (i < SIZE) ? v[i] : overflow[i - SIZE];
+				});
+
+				// the gaps (before the first slot and after the last block, the whole bucket without full blocks) take the
+				// spill and the partial buffers
+				parallelFor(BASE, [&v, &stripes, &spills, &spillCount, &start, &firstSlot, &fullBlocks](Index b) {
+					const Index LAST_END = (firstSlot[b] + fullBlocks[b]) * BLOCK;
+					const Index HEAD_END = (fullBlocks[b] == 0) ? start[b + 1] : firstSlot[b] * BLOCK;
+
+					Index pos = start[b];
+					auto fillGaps = [&v, &pos, HEAD_END, LAST_END](const T* items, Index n) {
+						for (Index i = 0; i < n; i++)
+						{
+							if (pos == HEAD_END)
+								pos = LAST_END;
+
+							v[pos++] = items[i];
+						}
+					};
+
+					fillGaps(spills.data() + b * BLOCK, spillCount[b]);
+					for (const auto& stripe : stripes)
+						fillGaps(stripe.buffer.data() + b * BLOCK, stripe.fill[b]);
+				});
+
+				return count;
+			}
+
+			// Block-based in-place MSD radix sort: regions from parallelScatterThreshold items are partitioned by all threads
+			// with partitionInPlace, smaller buckets go to single threads (largest first) and sortInPlaceMsd. Also the faster
+			// engine for large inputs on one thread, its buffered classification reads and writes sequentially.
+			template <typename T, typename GetBits>
+			inline void sortInPlaceBlocks(std::span<T> v, Index len, const Options& options, Index numOfThreads, GetBits&& getBits)
+			{
+				if (len == 0)
+					return;
+
+				std::vector<Region> large;
+				std::vector<Region> small;
+				large.emplace_back(0, v.size(), len, (len - 1) * SHIFT_BITS);
+
+				while (!large.empty())
+				{
+					const Region region = large.back();
+					large.pop_back();
+
+					const Index shift = region.curShiftOrIndex;
+					auto getDigit = [&getBits, shift](const T& item) {
+						return static_cast<Index>((getBits(item) >> shift) & MASK);
+					};
+
+					std::array<Index, BASE> count = partitionInPlace(v.subspan(region.l, region.r - region.l), numOfThreads, getDigit);
+
+					if (shift == 0)
+						continue;
+
+					for (Index b = 0, l = region.l; b < BASE; l += count[b++])
+					{
+						if (count[b] <= 1)
+							continue;
+
+						if (count[b] >= options.parallelScatterThreshold)
+							large.emplace_back(l, l + count[b], region.len, shift - SHIFT_BITS);
+						else
+							small.emplace_back(l, l + count[b], region.len, shift - SHIFT_BITS);
+					}
+				}
+
+				std::sort(small.begin(), small.end(), [](const Region& a, const Region& b) {
+					return a.r - a.l > b.r - b.l;
+				});
+
+				std::atomic<Index> next = 0;
+				ThreadPool::instance().run(numOfThreads, [&v, &small, &next, &options, &getBits](Index, Index) {
+					for (Index i = next.fetch_add(1, std::memory_order_relaxed); i < small.size(); i = next.fetch_add(1, std::memory_order_relaxed))
+					{
+						const Region& region = small[i];
+						sortInPlaceMsd(v.subspan(region.l, region.r - region.l), region.curShiftOrIndex / SHIFT_BITS + 1, options, getBits);
+					}
+				});
+			}
+		}
+
+		// =======================
+		// -----T sorted by T-----
+		// =======================
+
+		namespace value
+		{
+			using namespace shared;
+			
+			// =================
+			// -----Helpers-----
+			// =================
+			
+			template <typename T>
+			inline bool isSortedBi(std::vector<T>& v)
+			{
+				if (v.size() < 2)
+					return true;
+
+				constexpr auto cmpLess = (is_floating_point<T>) ?
+					[](const T& a, const T& b) { return std::strong_order(a, b) < 0; } :
+					[](const T& a, const T& b) { return a < b; };
+
+				constexpr auto cmpGreater = (is_floating_point<T>) ?
+					[](const T& a, const T& b) { return std::strong_order(a, b) > 0; } :
+					[](const T& a, const T& b) { return a > b; };
+
+				bool sortedAsc = true;
+				bool sortedDesc = true;
+
+				for (Index i = 0, size = v.size() - 1; i < size; i++)
+				{
+					if (sortedAsc && cmpGreater(v[i], v[i + 1]))
+						sortedAsc = false;
+					if (sortedDesc && cmpLess(v[i], v[i + 1]))
+						sortedDesc = false;
+					if (!sortedAsc && !sortedDesc)
+						break;
+				}
+
+				if (sortedAsc)
+					return true;
+				else if (sortedDesc)
+				{
+					std::reverse(v.begin(), v.end());
+					return true;
+				}
+
+				return false;
+			}
+
+			template <typename T>
+			inline Index getMaxLength(std::span<T> v)
+			{
+				Index len = 0;
+				constexpr Index MAX_LEN = sizeof(T);
+
+				if constexpr (MAX_LEN == 1 || is_floating_point<T>)
+				{
+					return MAX_LEN;
+				}
+				if constexpr (std::integral<T>)
+				{
+					// the OR of the keys has the bit width of the largest one, a negative key sets the top byte
+					using U = alias_unsigned<T>;
+					constexpr U TOP_BYTE = U(MASK) << ((MAX_LEN - 1) * SHIFT_BITS);
+					const U* keys = reinterpret_cast<const U*>(v.data());
+					const Index SIZE = v.size();
+					U bits = 0;
+
+					for (Index l = 0; l < SIZE; l += MAX_LENGTH_BLOCK)
+					{
+						bits |= orKeys(keys + l, std::min(MAX_LENGTH_BLOCK, SIZE - l));
+						if (bits & TOP_BYTE)
+							return MAX_LEN;
+					}
+
+					len = (std::bit_width(bits) + SHIFT_BITS - 1) / SHIFT_BITS;
+				}
+				else if constexpr (is_string<T>)
+				{
+					len = (*std::max_element(v.begin(), v.end(),
+						[](const std::string& a, const std::string& b) {
+							return a.length() < b.length();
+						})).length();
+				}
+
+				return len;
+			}
+
+			template <typename T>
+			inline void insertionSort(std::span<T> v, Index l, Index r)
+			{
+				constexpr auto cmp = (is_floating_point<T>) ?
+					[](const T& a, const T& b) { return std::strong_order(a, b) < 0; } :
+					[](const T& a, const T& b) { return a < b; };
+
+				for (Index i = l + 1; i < r; i++)
+				{
+					T val = std::move(v[i]);
+					Index j = i;
+
+					while (j > l && cmp(val, v[j - 1]))
+					{
+						v[j] = std::move(v[j - 1]);
+						j--;
+					}
+
+					v[j] = std::move(val);
+				}
+			}
+
+			// buckets of integers go to the networks and SIMD kernels while they fit them, the rest to insertion sort
+			template <typename T>
+			inline void sortSmall(std::span<T> v, Index l, Index r)
+			{
+				if constexpr (std::integral<T>)
+				{
+					if (sortSmallKeys(v.data() + l, r - l))
+						return;
+				}
+
+				insertionSort(v, l, r);
+			}
+
+			// the bytes of n objects reused as n U objects (std::start_lifetime_as_array before C++23),
+			// memmove implicitly creates the U objects and compilers drop a copy onto itself
+			template <typename U>
+			inline U* reuseStorageAs(void* storage, Index n)
+			{
+				return std::launder(static_cast<U*>(std::memmove(storage, storage, n * sizeof(U))));
+			}
+
+			template <typename U>
+			inline void getUnsignedVectorThread(std::byte* storage, bool reverse, Index l, Index r)
+			{
+				convertFloatBits<U>(storage + l * sizeof(U), storage + l * sizeof(U), r - l, reverse);
+			}
+
+			// Float keys are turned into radix-ordered unsigned bits inside v's own storage (and back when reverse),
+			// sorting them needs no second array and the conversion reads and writes the same cache lines.
+			template <typename T, typename U = t2u<T>>
+			inline void getUnsignedVector(std::vector<T>& v, bool reverse, const Options& options)
+			{
+				const Index SIZE = v.size();
+				Index numOfThreads = getNumOfThreads(SIZE, options);
+				std::byte* storage = reinterpret_cast<std::byte*>(v.data());
+
+				if (!options.enableMultiThreading || numOfThreads <= 1)
 				{
-					getUnsignedVectorThread(v, vu, reverse, 0, SIZE);
+					getUnsignedVectorThread<U>(storage, reverse, 0, SIZE);
 				}
 				else
 				{
-					std::vector<std::thread> threads;
 					Index bucketSize = SIZE / numOfThreads;
 
-					for (Index i = 0; i < numOfThreads; i++)
-					{
+					parallelFor(numOfThreads, [storage, reverse, SIZE, bucketSize, numOfThreads](Index i) {
 						Index start = i * bucketSize;
 						Index end = (i == numOfThreads - 1) ? SIZE : start + bucketSize;
-						threads.emplace_back([&v, &vu, reverse, start, end]() {
-							getUnsignedVectorThread(v, vu, reverse, start, end);
+						getUnsignedVectorThread<U>(storage, reverse, start, end);
+					});
+				}
+			}
+
+			template <Index BITS = SHIFT_BITS, typename T>
+			inline void getSortedVector(std::span<T> v, std::span<T> tmp, std::vector<Index>& prefix, Index curShift, Scatter scatter)
+			{
+				if constexpr (is_line_scatterable<T>)
+				{
+					if (scatter != Scatter::DIRECT)
+					{
+						Index flip = getSignFlip<T, BITS>(curShift);
+
+						scatterBuffered<BITS>(v, tmp, prefix, 0, v.size(), scatter, [curShift, flip](const T& num) {
+							return ((static_cast<t2u<T>>(num) >> curShift) & DIGIT_MASK<BITS>) ^ flip;
 						});
+						return;
 					}
-
-					for (auto& t : threads)
-						t.join();
 				}
-			}
 
-			template <typename T>
-			inline void getSortedVector(std::vector<T>& v, std::vector<T>& tmp, std::vector<Index>& prefix, Index curShift)
-			{
 				if constexpr (std::unsigned_integral<T>)
 				{
 					for (const auto& num : v)
-						tmp[prefix[(num >> curShift) & MASK]++] = num;
+						tmp[prefix[(num >> curShift) & DIGIT_MASK<BITS>]++] = num;
 				}
 				else if constexpr (std::signed_integral<T>)
 				{
-					constexpr Index MAX_SHIFT = (sizeof(T) - 1) * 8;
+					Index flip = getSignFlip<T, BITS>(curShift);
 
-					if (curShift != MAX_SHIFT)
+					if (flip == 0)
 					{
 						for (const auto& num : v)
-							tmp[prefix[(static_cast<t2u<T>>(num) >> curShift) & MASK]++] = num;
+							tmp[prefix[(static_cast<t2u<T>>(num) >> curShift) & DIGIT_MASK<BITS>]++] = num;
 					}
 					else
 					{
 						for (const auto& num : v)
-							tmp[prefix[((static_cast<t2u<T>>(num) >> curShift) & MASK) ^ INVERT_MASK]++] = num;
+							tmp[prefix[((static_cast<t2u<T>>(num) >> curShift) & DIGIT_MASK<BITS>) ^ flip]++] = num;
 					}
 				}
 			}
 
-			template <typename T>
-			inline void getSortedVector(std::vector<T>& v, std::vector<T>& tmp, std::vector<Index>& prefix, Index curShiftOrIndex, Index l, Index r)
+			template <Index BITS = SHIFT_BITS, typename T>
+			inline void getSortedVector(std::span<T> v, std::span<T> tmp, std::vector<Index>& prefix, Index curShiftOrIndex, Index l, Index r, Scatter scatter, bool construct = false)
 			{
+				if constexpr (is_line_scatterable<T>)
+				{
+					if (scatter != Scatter::DIRECT)
+					{
+						Index flip = getSignFlip<T, BITS>(curShiftOrIndex);
+
+						scatterBuffered<BITS>(v, tmp, prefix, l, r, scatter, [curShiftOrIndex, flip](const T& num) {
+							return ((static_cast<t2u<T>>(num) >> curShiftOrIndex) & DIGIT_MASK<BITS>) ^ flip;
+						});
+						return;
+					}
+				}
+
 				if constexpr (is_string<T>)
 				{
 					for (auto& str : std::span(v).subspan(l, r - l))
-						tmp[prefix[getChar(str, curShiftOrIndex)]++] = std::move(str);
+						putItem(tmp, prefix[getChar(str, curShiftOrIndex)]++, std::move(str), construct);
 				}
 				else if constexpr (std::unsigned_integral<T>)
 				{
 					for (const auto& num : std::span(v).subspan(l, r - l))
-						tmp[prefix[(num >> curShiftOrIndex) & MASK]++] = num;
+						tmp[prefix[(num >> curShiftOrIndex) & DIGIT_MASK<BITS>]++] = num;
 				}
 				else if constexpr (std::signed_integral<T>)
 				{
-					constexpr Index MAX_SHIFT = (sizeof(T) - 1) * 8;
+					Index flip = getSignFlip<T, BITS>(curShiftOrIndex);
 
-					if (curShiftOrIndex != MAX_SHIFT)
+					if (flip == 0)
 					{
 						for (const auto& num : std::span(v).subspan(l, r - l))
-							tmp[prefix[(static_cast<t2u<T>>(num) >> curShiftOrIndex) & MASK]++] = num;
+							tmp[prefix[(static_cast<t2u<T>>(num) >> curShiftOrIndex) & DIGIT_MASK<BITS>]++] = num;
 					}
 					else
 					{
 						for (const auto& num : std::span(v).subspan(l, r - l))
-							tmp[prefix[((static_cast<t2u<T>>(num) >> curShiftOrIndex) & MASK) ^ INVERT_MASK]++] = num;
+							tmp[prefix[((static_cast<t2u<T>>(num) >> curShiftOrIndex) & DIGIT_MASK<BITS>) ^ flip]++] = num;
 					}
 				}
 			}
@@ -503,39 +3405,129 @@ namespace radix_sort
 			// -----Implementations-----
 			// =========================
 		
-			template <typename T>
-			inline void sortLsd(std::vector<T>& v, Index len, bool enableMultiThreading)
+			template <Index BITS, typename T>
+			inline void sortLsd(std::span<T> v, Index len, const Options& options)
 			{
 				const Index SIZE = v.size();
-				std::vector<T> tmp(SIZE);
-				Index curShift = 0;
+				Index numOfThreads = (options.enableMultiThreading) ? getNumOfThreads(SIZE, options) : 1;
+				ScratchBuffer<T> scratch(SIZE, numOfThreads, getArena(options));
+				std::span<T> src = v;
+				std::span<T> dst = scratch.span();
+
+				// every digit is counted in one read of v, the chunk histograms stay valid until the first pass moves anything
+				const Index PASSES = getDigitPasses(len, BITS);
+				std::vector<Index> counts;
+				std::vector<std::vector<Index>> chunkCounts;
+				getDigitCounts<BITS>(counts, chunkCounts, SIZE, PASSES, numOfThreads,
+					[&v, PASSES](std::vector<Index>& chunkCount, Index start, Index end) {
+						getCountVectorsThread<BITS>(v, chunkCount, PASSES, start, end);
+					});
+
+				const Scatter SCATTER = getScatter<T, BITS>(SIZE, options, false);
+				bool isFirstPass = true;
+
+				for (Index digit = 0; digit < PASSES; digit++)
+				{
+					if (isTrivialDigit<BITS>(counts, digit, SIZE))
+						continue;
+
+					Index curShift = digit * BITS;
+					std::vector<Index> count(DIGIT_BASE<BITS>);
+
+					if (numOfThreads > 1)
+					{
+						auto scatterChunk = [&src, &dst, curShift, SCATTER](std::vector<Index>& chunkPrefix, Index start, Index end) {
+							getSortedVector<BITS>(src, dst, chunkPrefix, curShift, start, end, SCATTER);
+						};
+
+						if (isFirstPass)
+						{
+							std::vector<std::vector<Index>> digitCounts = getDigitChunkCounts<BITS>(chunkCounts, digit);
+							parallelScatter<T, BITS>(count, digitCounts, 0, SIZE, numOfThreads, scatterChunk);
+						}
+						else
+						{
+							parallelScatter<T, BITS>(count, 0, SIZE, numOfThreads,
+								[&src, curShift](std::vector<Index>& chunkCount, Index start, Index end) {
+									getCountVectorThread<BITS>(src, chunkCount, curShift, start, end);
+								},
+								scatterChunk);
+						}
+					}
+					else
+					{
+						std::vector<Index> prefix(DIGIT_BASE<BITS>);
+
+						std::copy_n(counts.begin() + digit * DIGIT_BASE<BITS>, DIGIT_BASE<BITS>, count.begin());
+						getPrefixVector<T, BITS>(prefix, count, 0);
+						getSortedVector<BITS>(src, dst, prefix, curShift, SCATTER);
+					}
 
-				while (len--)
+					std::swap(src, dst);
+					isFirstPass = false;
+				}
+
+				if (src.data() != v.data())
+					moveBuffer(src, v, numOfThreads);
+			}
+
+			// digit width from the size and scatter of the array, see getDigitBits
+			template <typename T>
+			inline void sortLsdInit(std::span<T> v, Index len, const Options& options)
+			{
+				switch (getDigitBits<T>(v.size(), len, options))
 				{
-					std::vector<Index> count(BASE);
-					std::vector<Index> prefix(BASE);
+					case WIDE_DIGIT_BITS:
+						sortLsd<WIDE_DIGIT_BITS>(v, len, options);
+						break;
+					case MAX_DIGIT_BITS:
+						sortLsd<MAX_DIGIT_BITS>(v, len, options);
+						break;
+					default:
+						sortLsd<SHIFT_BITS>(v, len, options);
+						break;
+				}
+			}
 
-					getCountVector(v, count, curShift, 0, SIZE, enableMultiThreading);
-					getPrefixVector<T>(prefix, count, 0);
-					getSortedVector(v, tmp, prefix, curShift);
+			// Sorts [l, r) by its len low bytes with an LSD alternating between src and dst, meant for regions that fit the cache:
+			// a few sequential passes cost less than more MSD levels of up to BASE regions each. Returns whether it ended in dst.
+			template <typename T>
+			inline bool sortLsdRegion(std::span<T> src, std::span<T> dst, MsdWorkspace& workspace, Index len, Index l, Index r)
+			{
+				std::vector<Index>& counts = workspace.digitCounts;
+				counts.assign(len * BASE, 0);
+				getCountVectorsThread(src, counts, len, l, r);
 
-					std::swap(v, tmp);
+				bool inDst = false;
+				for (Index digit = 0; digit < len; digit++)
+				{
+					if (isTrivialDigit(counts, digit, r - l))
+						continue;
 
-					curShift += SHIFT_BITS;
+					std::copy_n(counts.begin() + digit * BASE, BASE, workspace.count.begin());
+					getPrefixVector<T>(workspace.prefix, workspace.count, l);
+					getSortedVector((inDst) ? dst : src, (inDst) ? src : dst, workspace.prefix, digit * SHIFT_BITS, l, r, Scatter::DIRECT);
+					inDst = !inDst;
 				}
+
+				return inDst;
 			}
 
 			template <typename T>
-			inline void sortMsd(std::vector<T>& v, std::vector<T>& tmp,
-				std::vector<Region>& regions, std::unique_lock<std::mutex>& lkRegions,
-				Region initialRegion, bool enableMultiThreading)
+			inline void sortMsd(std::span<T> v, std::span<T> tmp,
+				RegionScheduler& scheduler, Index workerIndex, MsdWorkspace& workspace,
+				Region initialRegion, const Options& options, bool enableMultiThreading)
 			{
-				std::vector<Region> regionsLocal;
-				regionsLocal.reserve(v.size() / 100);
+				std::vector<Region>& regionsLocal = workspace.regions;
+				std::vector<Index>& count = workspace.count;
+				std::vector<Index>& prefix = workspace.prefix;
 				regionsLocal.emplace_back(initialRegion);
 
-				constexpr Index INSERTION_SORT_THRESHOLD = (is_string<T>) ? INSERTION_SORT_THRESHOLD_STR : INSERTION_SORT_THRESHOLD_ALL;
-				constexpr Index ALLOC_SIZE = (is_string<T>) ? CHARS_ALLOC : BASE;
+				const Index INSERTION_SORT_THRESHOLD = (is_string<T>) ? options.insertionSortThresholdStr : getSmallSortThreshold<T>(options.insertionSortThresholdAll);
+
+				const auto moveBack = [&v, &tmp](Index start, Index end) {
+					std::move(tmp.begin() + start, tmp.begin() + end, v.begin() + start);
+				};
 
 				while (regionsLocal.size())
 				{
@@ -546,20 +3538,31 @@ namespace radix_sort
 					Index r = region.r;
 					Index len = region.len;
 					Index curShiftOrIndex = region.curShiftOrIndex;
+					bool inTmp = region.inTmp;
 
+					// every level scatters into the other array, a region is only copied into v once it is final
 					if (r - l < 2 || len == 0)
+					{
+						if (inTmp)
+							moveBack(l, r);
 						continue;
+					}
 
 					if (r - l <= INSERTION_SORT_THRESHOLD)
 					{
-						insertionSort(v, l, r);
+						if (inTmp)
+							moveBack(l, r);
+						sortSmall(v, l, r);
 						continue;
 					}
 
 					if constexpr (is_string<T>)
 					{
-						if (curShiftOrIndex >= STRING_MSD_MAX_DEPTH)
+						if (curShiftOrIndex >= options.stringMsdMaxDepth)
 						{
+							if (inTmp)
+								moveBack(l, r);
+
 							if (enableMultiThreading)
 								std::sort(std::execution::par, v.begin() + l, v.begin() + r);
 							else
@@ -568,113 +3571,241 @@ namespace radix_sort
 						}
 					}
 
-					std::vector<Index> count(ALLOC_SIZE);
-					std::vector<Index> prefix(ALLOC_SIZE);
+					std::span<T> src = (inTmp) ? tmp : v;
+					std::span<T> dst = (inTmp) ? v : tmp;
 
-					getCountVector(v, count, curShiftOrIndex, l, r, enableMultiThreading);
-					getPrefixVector<T>(prefix, count, l);
-					getSortedVector(v, tmp, prefix, curShiftOrIndex, l, r);
+					if constexpr (!is_string<T>)
+					{
+						if ((r - l) * sizeof(T) <= options.msdLsdThresholdBytes)
+						{
+							if (sortLsdRegion(src, dst, workspace, len, l, r) != inTmp)
+								moveBack(l, r);
+							continue;
+						}
+					}
 
-					std::move(tmp.begin() + l, tmp.begin() + r, v.begin() + l);
+					std::fill(count.begin(), count.end(), 0);
 
+					getCountVector(src, workspace, curShiftOrIndex, l, r, options, enableMultiThreading);
+					getPrefixVector<T>(prefix, count, l);
+					getSortedVector(src, dst, prefix, curShiftOrIndex, l, r, getScatter<T>(r - l, options, true), workspace.isTmpRaw);
+					workspace.isTmpRaw = false;
+
+					// a region that still fits the caches is cheaper to copy back whole than to track bucket by bucket
 					len--;
+					bool childrenInTmp = !inTmp;
+					if (childrenInTmp && (len == 0 || (r - l) * sizeof(T) < MSD_COPY_BACK_THRESHOLD_BYTES))
+					{
+						moveBack(l, r);
+						childrenInTmp = false;
+					}
+
 					if (len == 0)
 						continue;
 
-					partitionRegions<T>(count, regionsLocal, regions, lkRegions, len, curShiftOrIndex, l, enableMultiThreading);
+					if (childrenInTmp)
+						moveBackSettled<T>(count, l, moveBack);
+
+					partitionRegions<T>(count, regionsLocal, scheduler, workerIndex, len, curShiftOrIndex, l, childrenInTmp, options, enableMultiThreading);
 				}
 			}
 
 			template <typename T>
-			inline void sortMsdThread(std::vector<T>& v, std::vector<T>& tmp,
-				std::vector<Region>& regions, std::mutex& regionsLock,
-				Index& runningCounter, Index threadIndex)
+			inline void sortMsdThread(std::span<T> v, std::span<T> tmp,
+				RegionScheduler& scheduler, Index threadIndex, const Options& options)
 			{
-				std::unique_lock<std::mutex> lkRegions(regionsLock, std::defer_lock);
-
-				bool isIdle = false;
+				Region region;
+				MsdWorkspace workspace((is_string<T>) ? CHARS_ALLOC : BASE);
 				Index iterationsIdle = 0;
 
 				while (true)
 				{
-					lkRegions.lock();
-					if (regions.size())
+					if (scheduler.acquire(threadIndex, region))
 					{
-						Region region = std::move(regions.back());
-						regions.pop_back();
-
-						if (isIdle)
-						{
-							isIdle = false;
-							runningCounter++;
-							iterationsIdle = 0;
-						}
-
-						lkRegions.unlock();
-						sortMsd(v, tmp, regions, lkRegions, region, 1);
+						iterationsIdle = 0;
+						sortMsd(v, tmp, scheduler, threadIndex, workspace, region, options, true);
+						scheduler.complete();
 					}
 					else
 					{
-						if (!isIdle)
-						{
-							isIdle = true;
-							runningCounter--;
-						}
-
-						if (runningCounter == 0)
-						{
-							lkRegions.unlock();
+						if (scheduler.finished())
 							break;
-						}
 
-						lkRegions.unlock();
 						iterationsIdle++;
 
-						if (iterationsIdle > SLEEP_ITERATIONS_THRESHOLD)
+						if (iterationsIdle > SPIN_ITERATIONS_THRESHOLD)
 						{
 							iterationsIdle = 0;
-							std::this_thread::sleep_for(std::chrono::nanoseconds(1));
+							scheduler.park();
 						}
 					}
 				}
 			}
 
 			template <typename T>
-			inline void sortMsdInit(std::vector<T>& v, Index len, bool enableMultiThreading)
+			inline void sortMsdInit(std::span<T> v, Index len, const Options& options)
 			{
 				const Index SIZE = v.size();
-				std::vector<T> tmp(SIZE);
 				Index curShiftOrIndex = (is_string<T>) ? 0 : (len - 1) * 8;
-				Index numOfThreads = getNumOfThreads(SIZE);
+				Index numOfThreads = getNumOfThreads(SIZE, options);
+				ScratchBuffer<T> scratch(SIZE, (options.enableMultiThreading) ? numOfThreads : 1, getArena(options));
+				std::span<T> tmp = scratch.span();
 
-				if (!enableMultiThreading || numOfThreads <= 1)
+				if (!options.enableMultiThreading || numOfThreads <= 1)
 				{
-					std::mutex tmpMutex;
-					std::unique_lock<std::mutex> tmpLock(tmpMutex, std::defer_lock);
+					RegionScheduler tmpScheduler(1);
+					MsdWorkspace workspace((is_string<T>) ? CHARS_ALLOC : BASE);
+					workspace.isTmpRaw = scratch.isRaw();
+					sortMsd(v, tmp, tmpScheduler, 0, workspace, Region(0, SIZE, len, curShiftOrIndex), options, false);
 
-					std::vector<Region> tmpVector;
-					sortMsd(v, tmp, tmpVector, tmpLock, Region(0, SIZE, len, curShiftOrIndex), false);
+					if (!workspace.isTmpRaw)
+						scratch.setConstructed();
 				}
 				else
 				{
-					std::vector<std::thread> threads;
-					std::mutex regionsLock;
-					Index runningCounter = numOfThreads;
+					RegionScheduler scheduler(numOfThreads);
+					const Scatter SCATTER = getScatter<T>(SIZE, options, true);
+
+					bool isTmpRaw = partitionTopLevels<T>(scheduler, numOfThreads, Region(0, SIZE, len, curShiftOrIndex), scratch.isRaw(), options,
+						[&v, &tmp](std::vector<Index>& chunkCount, Index curShiftOrIndex, bool inTmp, Index start, Index end) {
+							getCountVectorThread((inTmp) ? tmp : v, chunkCount, curShiftOrIndex, start, end);
+						},
+						[&v, &tmp, SCATTER](std::vector<Index>& chunkPrefix, Index curShiftOrIndex, bool inTmp, bool construct, Index start, Index end) {
+							getSortedVector((inTmp) ? tmp : v, (inTmp) ? v : tmp, chunkPrefix, curShiftOrIndex, start, end, SCATTER, construct);
+						},
+						[&v, &tmp](Index start, Index end) {
+							std::move(tmp.begin() + start, tmp.begin() + end, v.begin() + start);
+						});
 
-					std::vector<Region> regions;
-					regions.reserve(1000);
-					regions.emplace_back(0, SIZE, len, curShiftOrIndex);
-					
-					for (Index i = 0; i < numOfThreads; i++)
+					// workers only scatter into constructed slots, a top level they sort themselves needs tmp built first
+					if (isTmpRaw)
+						scratch.construct();
+					else
+						scratch.setConstructed();
+
+					ThreadPool::instance().run(numOfThreads, [&v, &tmp, &scheduler, &options](Index i, Index) {
+						sortMsdThread(v, tmp, scheduler, i, options);
+					});
+				}
+			}
+
+			// Values are their own keys, so they are rebuilt from the histogram of the report's exact key range:
+			// every key value is written as many times as it was counted, without scratch and without random writes.
+			// With multi-threading the chunks are counted in parallel and the output is filled in equal slices.
+			template <typename T>
+			inline void sortCounting(std::span<T> v, const Report& report, const Options& options)
+			{
+				using U = t2u<T>;
+
+				const Index SIZE = v.size();
+				const Index RANGE = report.keyRange;
+				const Index ALLOC_SIZE = std::max(RANGE, BASE);
+				const U MIN_KEY = static_cast<U>(report.minKey);
+				Index numOfThreads = (options.enableMultiThreading) ? getNumOfThreads(SIZE, options) : 1;
+				Index bucketSize = SIZE / numOfThreads;
+				std::vector<Index> count(ALLOC_SIZE);
+
+				// ranges of one digit keep the interleaved sub histograms, wider ones count into one
+				auto countChunk = [&v, RANGE, MIN_KEY](std::vector<Index>& chunkCount, Index start, Index end) {
+					const T* nums = v.data() + start;
+					auto getDigit = [nums, MIN_KEY](Index i) {
+						return static_cast<Index>(static_cast<U>(getOrderedBits(nums[i]) - MIN_KEY));
+					};
+
+					if (RANGE <= BASE)
+						countDigit(end - start, chunkCount.data(), getDigit);
+					else
+						countDigit<COUNTING_SORT_BITS>(end - start, chunkCount.data(), getDigit);
+				};
+
+				// count[k] is the end of key k in the output, a slice starts at the first key ending past it.
+				// Dense ranges leave runs of a few items whose lengths no branch predicts, there every key writes
+				// COUNTING_FILL_RUN copies unconditionally and the following keys overwrite the extra ones.
+				auto fillSlice = [&v, &count, RANGE, MIN_KEY, IS_DENSE = SIZE < RANGE * COUNTING_FILL_RUN](Index start, Index end) {
+					Index key = std::upper_bound(count.begin(), count.begin() + RANGE, start) - count.begin();
+					Index i = start;
+
+					if (IS_DENSE)
 					{
-						threads.emplace_back([&v, &tmp, &regions, &regionsLock, &runningCounter, i]() {
-							sortMsdThread(v, tmp, regions, regionsLock, runningCounter, i);
-						});
+						for (; i + COUNTING_FILL_RUN <= end; key++)
+						{
+							Index next = std::min(count[key], end);
+							T num = fromOrderedBits<T>(static_cast<U>(MIN_KEY + key));
+
+							for (Index j = 0; j < COUNTING_FILL_RUN; j++)
+								v[i + j] = num;
+							for (Index j = i + COUNTING_FILL_RUN; j < next; j++)
+								v[j] = num;
+
+							i = next;
+						}
 					}
 
-					for (auto& t : threads)
-						t.join();
+					for (; i < end; key++)
+					{
+						Index next = std::min(count[key], end);
+						std::fill(v.begin() + i, v.begin() + next, fromOrderedBits<T>(static_cast<U>(MIN_KEY + key)));
+						i = next;
+					}
+				};
+
+				if (numOfThreads <= 1)
+				{
+					countChunk(count, 0, SIZE);
+					std::inclusive_scan(count.begin(), count.begin() + RANGE, count.begin());
+					fillSlice(0, SIZE);
+					return;
 				}
+
+				std::vector<std::vector<Index>> counts(numOfThreads, std::vector<Index>(ALLOC_SIZE));
+
+				parallelFor(numOfThreads, [&countChunk, &counts, SIZE, bucketSize, numOfThreads](Index i) {
+					Index start = i * bucketSize;
+					Index end = (i == numOfThreads - 1) ? SIZE : start + bucketSize;
+					countChunk(counts[i], start, end);
+				});
+
+				mergeCounts(counts, count);
+				std::inclusive_scan(count.begin(), count.begin() + RANGE, count.begin());
+
+				parallelFor(numOfThreads, [&fillSlice, SIZE, bucketSize, numOfThreads](Index i) {
+					Index start = i * bucketSize;
+					Index end = (i == numOfThreads - 1) ? SIZE : start + bucketSize;
+					fillSlice(start, end);
+				});
+			}
+
+			// floating point values are permuted as they are, their bits mapped on every read instead of converted into a copy
+			template <typename T>
+			inline void sortInPlace(std::span<T> v, const Options& options)
+			{
+				const Index LEN = getMaxLength(v);
+				const Index NUM_OF_THREADS = (options.enableMultiThreading) ? getNumOfThreads(v.size(), options) : 1;
+				auto getBits = [](const T& num) {
+					return getOrderedBits(num);
+				};
+
+				if (NUM_OF_THREADS > 1 || v.size() >= options.parallelScatterThreshold)
+					sortInPlaceBlocks(v, LEN, options, NUM_OF_THREADS, getBits);
+				else
+					sortInPlaceMsd(v, LEN, options, getBits);
+			}
+
+			// floating point values are ordered the way the radix passes order them (IEEE-754 totalOrder)
+			template <typename T>
+			inline void sortComparison(std::span<T> v, const Options& options)
+			{
+				auto comp = [](const T& a, const T& b) {
+					if constexpr (is_floating_point<T>)
+						return std::strong_order(a, b) < 0;
+					else
+						return a < b;
+				};
+
+				if (options.enableMultiThreading && getNumOfThreads(v.size(), options) > 1)
+					std::sort(std::execution::par, v.begin(), v.end(), comp);
+				else
+					std::sort(v.begin(), v.end(), comp);
 			}
 
 			// =====================
@@ -682,21 +3813,34 @@ namespace radix_sort
 			// =====================
 
 			template <typename T>
-			inline void selectSortStrategy(std::vector<T>& v, bool enableMultiThreading)
+			inline void selectSortStrategy(std::span<T> v, const Options& options)
 			{
 				Index len = getMaxLength(v);
-				Index numOfThreads = getNumOfThreads(v.size());
+				Report report = planStrategy<T, true>(v.size(), len, options, [&v](Index i) -> const T& { return v[i]; });
 
-				if (is_string<T> || (is_large_integral<T> && len > 1))
-					sortMsdInit(v, len, enableMultiThreading);
-				else if (is_small_integral<T> || len <= 1 || !enableMultiThreading || numOfThreads <= 1)
-					sortLsd(v, len, enableMultiThreading);
-				else
-					sortMsdInit(v, len, enableMultiThreading);
+				switch (report.strategy)
+				{
+					case Strategy::LSD:
+						if constexpr (!is_string<T>)
+							sortLsdInit(v, len, options);
+						break;
+					case Strategy::COUNTING:
+						if constexpr (!is_string<T>)
+							sortCounting(v, report, options);
+						break;
+					case Strategy::COMPARISON:
+						sortComparison(v, options);
+						break;
+					default:
+						sortMsdInit(v, len, options);
+						break;
+				}
+
+				setReport(options, std::move(report));
 			}
 
 			template <supported T>
-			inline void sortDispatcher(std::vector<T>& v, bool enableMultiThreading)
+			inline void sortDispatcher(std::vector<T>& v, const Options& options)
 			{
 				if constexpr (is_floating_point<T>)
 				{
@@ -706,25 +3850,50 @@ namespace radix_sort
 					);
 				}
 
-				if (isSortedBi(v))
+				// a plan that picked a radix engine was made on unsorted input, its batches skip the sortedness scan
+				bool isPlanned = options.plan && options.plan->covers(v.size()) && options.plan->decision.strategy != Strategy::COMPARISON;
+				if (!isPlanned && isSortedBi(v))
+				{
+					setReport(options, { Strategy::AUTO, "already sorted or reversed" });
 					return;
+				}
 
 				const Index SIZE = v.size();
-				constexpr Index INSERTION_SORT_THRESHOLD = (is_string<T>) ? INSERTION_SORT_THRESHOLD_STR : INSERTION_SORT_THRESHOLD_ALL;
+				const Index INSERTION_SORT_THRESHOLD = (is_string<T>) ? options.insertionSortThresholdStr : options.insertionSortThresholdAll;
 				if (SIZE <= INSERTION_SORT_THRESHOLD)
 				{
-					insertionSort(v, 0, SIZE);
+					sortSmall(std::span<T>(v), 0, SIZE);
+					setReport(options, { Strategy::AUTO, "insertion sort below threshold" });
+					return;
+				}
+
+				const Index SCRATCH_BYTES = SIZE * sizeof(T);
+				if (options.strategy == Strategy::COMPARISON || (is_string<T> && SCRATCH_BYTES > options.maxScratchBytes))
+				{
+					sortComparison(std::span<T>(v), options);
+					setReport(options, { Strategy::COMPARISON, (options.strategy == Strategy::COMPARISON) ? "forced by options" : "radix scratch exceeds maxScratchBytes" });
 					return;
 				}
 
+				// fixed-width keys whose scratch does not fit are radix sorted in place, strings ignore IN_PLACE
+				if constexpr (!is_string<T>)
+				{
+					if (options.strategy == Strategy::IN_PLACE || SCRATCH_BYTES > options.maxScratchBytes)
+					{
+						sortInPlace(std::span<T>(v), options);
+						setReport(options, { Strategy::IN_PLACE, (options.strategy == Strategy::IN_PLACE) ? "forced by options" : "radix scratch exceeds maxScratchBytes" });
+						return;
+					}
+				}
+
 				if constexpr (!is_floating_point<T>)
-					selectSortStrategy(v, enableMultiThreading);
+					selectSortStrategy(std::span<T>(v), options);
 				else 
 				{
-					std::vector<t2u<T>> vu(SIZE);
-					getUnsignedVector(v, vu, false, enableMultiThreading);
-					selectSortStrategy(vu, enableMultiThreading);
-					getUnsignedVector(v, vu, true, enableMultiThreading);
+					getUnsignedVector(v, false, options);
+					selectSortStrategy(std::span<t2u<T>>(reuseStorageAs<t2u<T>>(v.data(), SIZE), SIZE), options);
+					getUnsignedVector(v, true, options);
+					reuseStorageAs<T>(v.data(), SIZE);
 				}
 			}
 		}
@@ -737,6 +3906,7 @@ namespace radix_sort
 		{
 			using namespace shared;
 			using shared::getCountVectorThread;
+			using shared::getCountVectorsThread;
 			using shared::getCountVector;
 
 			// =================
@@ -840,7 +4010,7 @@ namespace radix_sort
 			}
 
 			template <typename T, typename Proj>
-			inline void insertionSort(std::vector<T>& v, Proj proj, Index l, Index r)
+			inline void insertionSort(std::span<T> v, Proj proj, Index l, Index r)
 			{
 				using Key = sort_key<T, Proj>;
 
@@ -865,7 +4035,7 @@ namespace radix_sort
 			}
 
 			template <typename T, typename Key>
-			inline void insertionSort(std::vector<T>& v, std::vector<Key>& k, Index l, Index r)
+			inline void insertionSort(std::span<T> v, std::span<Key> k, Index l, Index r)
 			{
 				constexpr auto cmp = (is_floating_point<Key>) ?
 					[](const Key& a, const Key& b) { return std::strong_order(a, b) < 0; } :
@@ -889,8 +4059,21 @@ namespace radix_sort
 				}
 			}
 
+			// v holds the positions of k's keys (the index path), small buckets of integer keys are sorted as (key, index) pairs
+			template <typename T, typename Key>
+			inline void sortSmall(std::span<T> v, std::span<Key> k, Index l, Index r)
+			{
+				if constexpr (std::unsigned_integral<T> && std::integral<Key>)
+				{
+					if (sortSmallPairs(k.data() + l, v.data() + l, r - l))
+						return;
+				}
+
+				insertionSort(v, k, l, r);
+			}
+
 			template <typename T, typename Proj, typename U>
-			inline void getUnsignedVectorThread(std::vector<T>& v, Proj proj, std::vector<U>& vu, Index l, Index r)
+			inline void getUnsignedVectorThread(std::vector<T>& v, Proj proj, std::span<U> vu, Index l, Index r)
 			{
 				constexpr Index SIGN_SHIFT = (sizeof(U) * 8) - 1;
 				constexpr U SIGN_MASK = 1LL << SIGN_SHIFT;
@@ -903,36 +4086,29 @@ namespace radix_sort
 			}
 
 			template <typename T, typename Proj, typename U>
-			inline void getUnsignedVector(std::vector<T>& v, Proj proj, std::vector<U>& vu, bool enableMultiThreading)
+			inline void getUnsignedVector(std::vector<T>& v, Proj proj, std::span<U> vu, const Options& options)
 			{
 				const Index SIZE = v.size();
-				Index numOfThreads = getNumOfThreads(SIZE);
+				Index numOfThreads = getNumOfThreads(SIZE, options);
 
-				if (!enableMultiThreading || numOfThreads <= 1)
+				if (!options.enableMultiThreading || numOfThreads <= 1)
 				{
 					getUnsignedVectorThread(v, proj, vu, 0, SIZE);
 				}
 				else
 				{
-					std::vector<std::thread> threads;
 					Index bucketSize = SIZE / numOfThreads;
 
-					for (Index i = 0; i < numOfThreads; i++)
-					{
+					parallelFor(numOfThreads, [&v, &proj, &vu, SIZE, bucketSize, numOfThreads](Index i) {
 						Index start = i * bucketSize;
 						Index end = (i == numOfThreads - 1) ? SIZE : start + bucketSize;
-						threads.emplace_back([&v, &proj, &vu, start, end]() {
-							getUnsignedVectorThread(v, proj, vu, start, end);
-						});
-					}
-
-					for (auto& t : threads)
-						t.join();
+						getUnsignedVectorThread(v, proj, vu, start, end);
+					});
 				}
 			}
 
-			template <typename T, typename Proj>
-			inline void getCountVectorThread(std::vector<T>& v, Proj proj, std::vector<Index>& count, Index curShiftOrIndex, Index l, Index r)
+			template <Index BITS = SHIFT_BITS, typename T, typename Proj>
+			inline void getCountVectorThread(std::span<T> v, Proj proj, std::vector<Index>& count, Index curShiftOrIndex, Index l, Index r)
 			{
 				using Key = sort_key<T, Proj>;
 
@@ -941,130 +4117,168 @@ namespace radix_sort
 					for (const auto& obj : std::span(v).subspan(l, r - l))
 						count[getChar(std::invoke(proj, obj), curShiftOrIndex)]++;
 				}
-				else if constexpr (std::unsigned_integral<Key>)
-				{
-					for (const auto& obj : std::span(v).subspan(l, r - l))
-						count[(std::invoke(proj, obj) >> curShiftOrIndex) & MASK]++;
-				}
-				else if constexpr (std::signed_integral<Key>)
+				else if constexpr (std::integral<Key>)
 				{
-					constexpr Index MAX_SHIFT = (sizeof(Key) - 1) * 8;
+					Index flip = getSignFlip<Key, BITS>(curShiftOrIndex);
+					const T* objs = v.data() + l;
 
-					if (curShiftOrIndex != MAX_SHIFT)
-					{
-						for (const auto& obj : std::span(v).subspan(l, r - l))
-							count[(static_cast<t2u<Key>>(std::invoke(proj, obj)) >> curShiftOrIndex) & MASK]++;
-					}
-					else
-					{
-						for (const auto& obj : std::span(v).subspan(l, r - l))
-							count[((static_cast<t2u<Key>>(std::invoke(proj, obj)) >> curShiftOrIndex) & MASK) ^ INVERT_MASK]++;
-					}
+					countDigit<BITS>(r - l, count.data(), [objs, &proj, curShiftOrIndex, flip](Index i) {
+						return ((static_cast<t2u<Key>>(std::invoke(proj, objs[i])) >> curShiftOrIndex) & DIGIT_MASK<BITS>) ^ flip;
+					});
 				}
 			}
 
-			template <typename T, typename Proj>
-			inline void getCountVector(std::vector<T>& v, Proj proj, std::vector<Index>& count, Index curShiftOrIndex, Index l, Index r, bool enableMultiThreading)
+			template <Index BITS = SHIFT_BITS, typename T, typename Proj>
+			inline void getCountVectorsThread(std::span<T> v, Proj proj, std::vector<Index>& counts, Index passes, Index l, Index r)
 			{
 				using Key = sort_key<T, Proj>;
+				using U = t2u<Key>;
+
+				countDigits<BITS, U>(std::span(v).subspan(l, r - l), counts, passes, [&proj](const T& obj) {
+					if constexpr (std::signed_integral<Key>)
+						return static_cast<U>(static_cast<U>(std::invoke(proj, obj)) ^ (static_cast<U>(INVERT_MASK) << ((sizeof(Key) - 1) * 8)));
+					else
+						return static_cast<U>(std::invoke(proj, obj));
+				});
+			}
 
+			template <typename T, typename Proj>
+			inline void getCountVector(std::span<T> v, Proj proj, MsdWorkspace& workspace, Index curShiftOrIndex, Index l, Index r, const Options& options, bool enableMultiThreading)
+			{
 				const Index SIZE = r - l;
-				Index numOfThreads = getNumOfThreads(SIZE);
+				Index numOfThreads = getNumOfThreads(SIZE, options);
 
 				if (!enableMultiThreading || numOfThreads <= 1)
 				{
-					getCountVectorThread(v, proj, count, curShiftOrIndex, l, r);
+					getCountVectorThread(v, proj, workspace.count, curShiftOrIndex, l, r);
 				}
 				else
 				{
-					constexpr Index ALLOC_SIZE = (std::same_as<Key, std::string>) ? CHARS_ALLOC : BASE;
-					std::vector<std::vector<Index>> counts(numOfThreads, std::vector<Index>(ALLOC_SIZE));
-
-					std::vector<std::thread> threads;
+					std::vector<std::vector<Index>>& counts = workspace.getCounts(numOfThreads);
 					Index bucketSize = SIZE / numOfThreads;
 
-					for (Index i = 0; i < numOfThreads; i++)
-					{
+					parallelFor(numOfThreads, [&v, &proj, &counts, curShiftOrIndex, l, r, bucketSize, numOfThreads](Index i) {
 						Index start = l + i * bucketSize;
 						Index end = (i == numOfThreads - 1) ? r : start + bucketSize;
-						threads.emplace_back([&v, &proj, &counts, i, curShiftOrIndex, start, end]() {
-								getCountVectorThread(v, proj, counts[i], curShiftOrIndex, start, end);
-						});
-					}
-
-					for (auto& t : threads)
-						t.join();
+						getCountVectorThread(v, proj, counts[i], curShiftOrIndex, start, end);
+					});
 
-					for (Index curThread = 0; curThread < numOfThreads; curThread++)
-					{
-						for (Index i = 0; i < ALLOC_SIZE; i++)
-							count[i] += counts[curThread][i];
-					}
+					mergeCounts(counts, workspace.count);
 				}
 			}
 
-			template <typename T, typename Proj>
-			inline void getSortedVector(std::vector<T>& v, Proj proj, std::vector<T>& tmp, std::vector<Index>& prefix, Index curShift)
+			template <Index BITS = SHIFT_BITS, typename T, typename Proj>
+			inline void getSortedVector(std::span<T> v, Proj proj, std::span<T> tmp, std::vector<Index>& prefix, Index curShift, Scatter scatter, bool construct = false)
 			{
 				using Key = sort_key<T, Proj>;
 
+				if constexpr (is_line_scatterable<T> && std::integral<Key>)
+				{
+					if (scatter != Scatter::DIRECT)
+					{
+						Index flip = getSignFlip<Key, BITS>(curShift);
+
+						scatterBuffered<BITS>(v, tmp, prefix, 0, v.size(), scatter, [&proj, curShift, flip](const T& obj) {
+							return ((static_cast<t2u<Key>>(std::invoke(proj, obj)) >> curShift) & DIGIT_MASK<BITS>) ^ flip;
+						});
+						return;
+					}
+				}
+
 				if constexpr (std::unsigned_integral<Key>)
 				{
 					for (auto& obj : v)
-						tmp[prefix[(std::invoke(proj, obj) >> curShift) & MASK]++] = std::move(obj);
+						putItem(tmp, prefix[(std::invoke(proj, obj) >> curShift) & DIGIT_MASK<BITS>]++, std::move(obj), construct);
 				}
 				else if constexpr (std::signed_integral<Key>)
 				{
-					constexpr Index MAX_SHIFT = (sizeof(Key) - 1) * 8;
+					Index flip = getSignFlip<Key, BITS>(curShift);
 
-					if (curShift != MAX_SHIFT)
+					if (flip == 0)
 					{
 						for (auto& obj : v)
-							tmp[prefix[(static_cast<t2u<Key>>(std::invoke(proj, obj)) >> curShift) & MASK]++] = std::move(obj);
+							putItem(tmp, prefix[(static_cast<t2u<Key>>(std::invoke(proj, obj)) >> curShift) & DIGIT_MASK<BITS>]++, std::move(obj), construct);
 					}
 					else
 					{
 						for (auto& obj : v)
-							tmp[prefix[((static_cast<t2u<Key>>(std::invoke(proj, obj)) >> curShift) & MASK) ^ INVERT_MASK]++] = std::move(obj);
+							putItem(tmp, prefix[((static_cast<t2u<Key>>(std::invoke(proj, obj)) >> curShift) & DIGIT_MASK<BITS>) ^ flip]++, std::move(obj), construct);
 					}
 				}
 			}
 
-			template <typename T, typename Proj>
-			inline void getSortedVector(std::vector<T>& v, Proj proj, std::vector<T>& tmp, std::vector<Index>& prefix, Index curShiftOrIndex, Index l, Index r)
+			template <Index BITS = SHIFT_BITS, typename T, typename Proj>
+			inline void getSortedVector(std::span<T> v, Proj proj, std::span<T> tmp, std::vector<Index>& prefix, Index curShiftOrIndex, Index l, Index r, Scatter scatter, bool construct = false)
 			{
 				using Key = sort_key<T, Proj>;
 
+				if constexpr (is_line_scatterable<T> && std::integral<Key>)
+				{
+					if (scatter != Scatter::DIRECT)
+					{
+						Index flip = getSignFlip<Key, BITS>(curShiftOrIndex);
+
+						scatterBuffered<BITS>(v, tmp, prefix, l, r, scatter, [&proj, curShiftOrIndex, flip](const T& obj) {
+							return ((static_cast<t2u<Key>>(std::invoke(proj, obj)) >> curShiftOrIndex) & DIGIT_MASK<BITS>) ^ flip;
+						});
+						return;
+					}
+				}
+
 				if constexpr (is_string<Key>)
 				{
 					for (auto& obj : std::span(v).subspan(l, r - l))
-						tmp[prefix[getChar(std::invoke(proj, obj), curShiftOrIndex)]++] = std::move(obj);
+						putItem(tmp, prefix[getChar(std::invoke(proj, obj), curShiftOrIndex)]++, std::move(obj), construct);
 				}
 				else if constexpr (std::unsigned_integral<Key>)
 				{
 					for (auto& obj : std::span(v).subspan(l, r - l))
-						tmp[prefix[(std::invoke(proj, obj) >> curShiftOrIndex) & MASK]++] = std::move(obj);
+						putItem(tmp, prefix[(std::invoke(proj, obj) >> curShiftOrIndex) & DIGIT_MASK<BITS>]++, std::move(obj), construct);
 				}
 				else if constexpr (std::signed_integral<Key>)
 				{
-					constexpr Index MAX_SHIFT = (sizeof(Key) - 1) * 8;
+					Index flip = getSignFlip<Key, BITS>(curShiftOrIndex);
 
-					if (curShiftOrIndex != MAX_SHIFT)
+					if (flip == 0)
 					{
 						for (auto& obj : std::span(v).subspan(l, r - l))
-							tmp[prefix[(static_cast<t2u<Key>>(std::invoke(proj, obj)) >> curShiftOrIndex) & MASK]++] = std::move(obj);
+							putItem(tmp, prefix[(static_cast<t2u<Key>>(std::invoke(proj, obj)) >> curShiftOrIndex) & DIGIT_MASK<BITS>]++, std::move(obj), construct);
 					}
 					else
 					{
 						for (auto& obj : std::span(v).subspan(l, r - l))
-							tmp[prefix[((static_cast<t2u<Key>>(std::invoke(proj, obj)) >> curShiftOrIndex) & MASK) ^ INVERT_MASK]++] = std::move(obj);
+							putItem(tmp, prefix[((static_cast<t2u<Key>>(std::invoke(proj, obj)) >> curShiftOrIndex) & DIGIT_MASK<BITS>) ^ flip]++, std::move(obj), construct);
 					}
 				}
 			}
 
-			template <typename T, typename Key>
-			inline void getSortedVector(std::vector<T>& v, std::vector<Key>& k, std::vector<T>& tmp, std::vector<Key>& tmpKey, std::vector<Index>& prefix, Index curShiftOrIndex, Index l, Index r)
+			template <Index BITS = SHIFT_BITS, typename T, typename Key>
+			inline void getSortedVector(std::span<T> v, std::span<Key> k, std::span<T> tmp, std::span<Key> tmpKey, std::vector<Index>& prefix, Index curShiftOrIndex, Index l, Index r, Scatter scatter)
 			{
+				if constexpr (is_line_scatterable<T> && std::integral<Key>)
+				{
+					if (scatter != Scatter::DIRECT)
+					{
+						// items and keys land at the same positions, each through its own combiner
+						Index flip = getSignFlip<Key, BITS>(curShiftOrIndex);
+						bool streaming = scatter == Scatter::STREAMING;
+
+						auto items = std::make_unique<WriteCombiner<T, BITS>>(tmp, prefix, streaming);
+						auto keys = std::make_unique<WriteCombiner<Key, BITS>>(tmpKey, prefix, streaming);
+
+						for (Index i = l; i < r; i++)
+						{
+							Index digit = ((static_cast<t2u<Key>>(k[i]) >> curShiftOrIndex) & DIGIT_MASK<BITS>) ^ flip;
+							items->push(digit, v[i]);
+							keys->push(digit, k[i]);
+						}
+
+						items->finish(prefix);
+						keys->finish(prefix);
+						return;
+					}
+				}
+
 				if constexpr (is_string<Key>)
 				{
 					for (Index i = l; i < r; i++)
@@ -1078,20 +4292,20 @@ namespace radix_sort
 				{
 					for (Index i = l; i < r; i++)
 					{
-						Index pos = prefix[(k[i] >> curShiftOrIndex) & MASK]++;
+						Index pos = prefix[(k[i] >> curShiftOrIndex) & DIGIT_MASK<BITS>]++;
 						tmp[pos] = std::move(v[i]);
 						tmpKey[pos] = std::move(k[i]);
 					}
 				}
 				else if constexpr (std::signed_integral<Key>)
 				{
-					constexpr Index MAX_SHIFT = (sizeof(Key) - 1) * 8;
+					Index flip = getSignFlip<Key, BITS>(curShiftOrIndex);
 
-					if (curShiftOrIndex != MAX_SHIFT)
+					if (flip == 0)
 					{
 						for (Index i = l; i < r; i++)
 						{
-							Index pos = prefix[(static_cast<t2u<Key>>(k[i]) >> curShiftOrIndex) & MASK]++;
+							Index pos = prefix[(static_cast<t2u<Key>>(k[i]) >> curShiftOrIndex) & DIGIT_MASK<BITS>]++;
 							tmp[pos] = std::move(v[i]);
 							tmpKey[pos] = std::move(k[i]);
 						}
@@ -1100,7 +4314,7 @@ namespace radix_sort
 					{
 						for (Index i = l; i < r; i++)
 						{
-							Index pos = prefix[((static_cast<t2u<Key>>(k[i]) >> curShiftOrIndex) & MASK) ^ INVERT_MASK]++;
+							Index pos = prefix[((static_cast<t2u<Key>>(k[i]) >> curShiftOrIndex) & DIGIT_MASK<BITS>) ^ flip]++;
 							tmp[pos] = std::move(v[i]);
 							tmpKey[pos] = std::move(k[i]);
 						}
@@ -1108,20 +4322,21 @@ namespace radix_sort
 				}
 			}
 
-			template <typename T>
-			inline void sortByIndicesThread(std::vector<T>& v, std::vector<T>& tmp, std::vector<Index>& indices, Index l, Index r)
+			template <typename T, typename I>
+			inline void sortByIndicesThread(std::vector<T>& v, std::span<T> tmp, std::span<I> indices, Index l, Index r)
 			{
 				for (Index i = l; i < r; i++)
-					tmp[i] = std::move(v[indices[i]]);
+					putItem(tmp, i, std::move(v[indices[i]]), true);
 			}
 
-			template <typename T>
-			inline void sortByIndices(std::vector<T>& v, std::vector<Index>& indices, bool enableMultiThreading)
+			template <typename T, typename I>
+			inline void sortByIndices(std::vector<T>& v, std::span<I> indices, const Options& options)
 			{
 				const Index SIZE = v.size();
-				Index numOfThreads = getNumOfThreads(SIZE);
+				Index numOfThreads = (options.enableMultiThreading) ? getNumOfThreads(SIZE, options) : 1;
 
-				if (!enableMultiThreading || numOfThreads <= 1)
+				// without kept scratch the gathered copy simply replaces v, with it the gather lands in the arena and is moved back
+				if (numOfThreads <= 1 && !getArena(options))
 				{
 					std::vector<T> tmp;
 					tmp.reserve(SIZE);
@@ -1133,23 +4348,19 @@ namespace radix_sort
 				}
 				else
 				{
-					std::vector<T> tmp(SIZE);
-					std::vector<std::thread> threads;
+					// the gather constructs the raw scratch, every chunk is built by the thread that moves it back
+					ScratchBuffer<T> scratch(SIZE, numOfThreads, getArena(options));
+					std::span<T> tmp = scratch.span();
 					Index bucketSize = SIZE / numOfThreads;
 
-					for (Index i = 0; i < numOfThreads; i++)
-					{
+					parallelFor(numOfThreads, [&v, &tmp, &indices, SIZE, bucketSize, numOfThreads](Index i) {
 						Index start = i * bucketSize;
 						Index end = (i == numOfThreads - 1) ? SIZE : start + bucketSize;
-						threads.emplace_back([&v, &tmp, &indices, start, end]() {
-							sortByIndicesThread(v, tmp, indices, start, end);
-						});
-					}
-
-					for (auto& t : threads)
-						t.join();
+						sortByIndicesThread(v, tmp, indices, start, end);
+					});
 
-					std::swap(tmp, v);
+					scratch.setConstructed();
+					moveBuffer(tmp, std::span<T>(v), numOfThreads);
 				}
 			}
 
@@ -1157,67 +4368,198 @@ namespace radix_sort
 			// -----Implementations-----
 			// =========================
 
-			template <typename T, typename Proj>
-			inline void sortLsd(std::vector<T>& v, Proj proj, Index len, bool enableMultiThreading)
+			template <Index BITS, typename T, typename Proj>
+			inline void sortLsd(std::span<T> v, Proj proj, Index len, const Options& options)
 			{
 				using Key = sort_key<T, Proj>;
 				
 				const Index SIZE = v.size();
-				std::vector<T> tmp(SIZE);
-				Index curShift = 0;
+				Index numOfThreads = (options.enableMultiThreading) ? getNumOfThreads(SIZE, options) : 1;
+				ScratchBuffer<T> scratch(SIZE, numOfThreads, getArena(options));
+				std::span<T> src = v;
+				std::span<T> dst = scratch.span();
+
+				const Index PASSES = getDigitPasses(len, BITS);
+				std::vector<Index> counts;
+				std::vector<std::vector<Index>> chunkCounts;
+				getDigitCounts<BITS>(counts, chunkCounts, SIZE, PASSES, numOfThreads,
+					[&v, &proj, PASSES](std::vector<Index>& chunkCount, Index start, Index end) {
+						getCountVectorsThread<BITS>(v, proj, chunkCount, PASSES, start, end);
+					});
+
+				const Scatter SCATTER = getScatter<T, BITS>(SIZE, options, false);
+				bool isFirstPass = true;
+
+				for (Index digit = 0; digit < PASSES; digit++)
+				{
+					if (isTrivialDigit<BITS>(counts, digit, SIZE))
+						continue;
+
+					Index curShift = digit * BITS;
+					std::vector<Index> count(DIGIT_BASE<BITS>);
+
+					// the first pass is the first write into the scratch, it constructs the slots when they are raw
+					bool construct = isFirstPass && scratch.isRaw();
+
+					if (numOfThreads > 1)
+					{
+						auto scatterChunk = [&src, &dst, &proj, curShift, SCATTER, construct](std::vector<Index>& chunkPrefix, Index start, Index end) {
+							getSortedVector<BITS>(src, proj, dst, chunkPrefix, curShift, start, end, SCATTER, construct);
+						};
+
+						if (isFirstPass)
+						{
+							std::vector<std::vector<Index>> digitCounts = getDigitChunkCounts<BITS>(chunkCounts, digit);
+							parallelScatter<Key, BITS>(count, digitCounts, 0, SIZE, numOfThreads, scatterChunk);
+						}
+						else
+						{
+							parallelScatter<Key, BITS>(count, 0, SIZE, numOfThreads,
+								[&src, &proj, curShift](std::vector<Index>& chunkCount, Index start, Index end) {
+									getCountVectorThread<BITS>(src, proj, chunkCount, curShift, start, end);
+								},
+								scatterChunk);
+						}
+					}
+					else
+					{
+						std::vector<Index> prefix(DIGIT_BASE<BITS>);
+
+						std::copy_n(counts.begin() + digit * DIGIT_BASE<BITS>, DIGIT_BASE<BITS>, count.begin());
+						getPrefixVector<Key, BITS>(prefix, count, 0);
+						getSortedVector<BITS>(src, proj, dst, prefix, curShift, SCATTER, construct);
+					}
+
+					std::swap(src, dst);
+					isFirstPass = false;
+					scratch.setConstructed();
+				}
+
+				if (src.data() != v.data())
+					moveBuffer(src, v, numOfThreads);
+			}
+
+			template <typename T, typename Proj>
+			inline void sortLsdInit(std::span<T> v, Proj proj, Index len, const Options& options)
+			{
+				switch (getDigitBits<T>(v.size(), len, options))
+				{
+					case WIDE_DIGIT_BITS:
+						sortLsd<WIDE_DIGIT_BITS>(v, proj, len, options);
+						break;
+					case MAX_DIGIT_BITS:
+						sortLsd<MAX_DIGIT_BITS>(v, proj, len, options);
+						break;
+					default:
+						sortLsd<SHIFT_BITS>(v, proj, len, options);
+						break;
+				}
+			}
+
+			template <Index BITS, typename T, typename Key>
+			inline void sortLsd(std::span<T> v, std::span<Key> k, Index len, const Options& options)
+			{
+				const Index SIZE = v.size();
+				Index numOfThreads = (options.enableMultiThreading) ? getNumOfThreads(SIZE, options) : 1;
+				ScratchBuffer<T> scratch(SIZE, numOfThreads, getArena(options));
+				ScratchBuffer<Key> scratchKey(SIZE, numOfThreads, getArena(options));
+				std::span<T> src = v;
+				std::span<T> dst = scratch.span();
+				std::span<Key> srcKey = k;
+				std::span<Key> dstKey = scratchKey.span();
+
+				const Index PASSES = getDigitPasses(len, BITS);
+				std::vector<Index> counts;
+				std::vector<std::vector<Index>> chunkCounts;
+				getDigitCounts<BITS>(counts, chunkCounts, SIZE, PASSES, numOfThreads,
+					[&k, PASSES](std::vector<Index>& chunkCount, Index start, Index end) {
+						getCountVectorsThread<BITS>(k, chunkCount, PASSES, start, end);
+					});
+
+				const Scatter SCATTER = getScatter<T, BITS>(SIZE, options, false);
+				bool isFirstPass = true;
+
+				for (Index digit = 0; digit < PASSES; digit++)
+				{
+					if (isTrivialDigit<BITS>(counts, digit, SIZE))
+						continue;
 
-				while (len--)
-				{
-					std::vector<Index> count(BASE);
-					std::vector<Index> prefix(BASE);
+					Index curShift = digit * BITS;
+					std::vector<Index> count(DIGIT_BASE<BITS>);
+
+					if (numOfThreads > 1)
+					{
+						auto scatterChunk = [&src, &srcKey, &dst, &dstKey, curShift, SCATTER](std::vector<Index>& chunkPrefix, Index start, Index end) {
+							getSortedVector<BITS>(src, srcKey, dst, dstKey, chunkPrefix, curShift, start, end, SCATTER);
+						};
 
-					getCountVector(v, proj, count, curShift, 0, SIZE, enableMultiThreading);
-					getPrefixVector<Key>(prefix, count, 0);
-					getSortedVector(v, proj, tmp, prefix, curShift);
+						if (isFirstPass)
+						{
+							std::vector<std::vector<Index>> digitCounts = getDigitChunkCounts<BITS>(chunkCounts, digit);
+							parallelScatter<Key, BITS>(count, digitCounts, 0, SIZE, numOfThreads, scatterChunk);
+						}
+						else
+						{
+							parallelScatter<Key, BITS>(count, 0, SIZE, numOfThreads,
+								[&srcKey, curShift](std::vector<Index>& chunkCount, Index start, Index end) {
+									getCountVectorThread<BITS>(srcKey, chunkCount, curShift, start, end);
+								},
+								scatterChunk);
+						}
+					}
+					else
+					{
+						std::vector<Index> prefix(DIGIT_BASE<BITS>);
 
-					std::swap(v, tmp);
+						std::copy_n(counts.begin() + digit * DIGIT_BASE<BITS>, DIGIT_BASE<BITS>, count.begin());
+						getPrefixVector<Key, BITS>(prefix, count, 0);
+						getSortedVector<BITS>(src, srcKey, dst, dstKey, prefix, curShift, 0, SIZE, SCATTER);
+					}
 
-					curShift += SHIFT_BITS;
+					std::swap(src, dst);
+					std::swap(srcKey, dstKey);
+					isFirstPass = false;
 				}
+
+				// k is the caller's key scratch and is not read afterwards, only v has to end up in place
+				if (src.data() != v.data())
+					moveBuffer(src, v, numOfThreads);
 			}
 
 			template <typename T, typename Key>
-			inline void sortLsd(std::vector<T>& v, std::vector<Key>& k, Index len, bool enableMultiThreading)
+			inline void sortLsdInit(std::span<T> v, std::span<Key> k, Index len, const Options& options)
 			{
-				const Index SIZE = v.size();
-				std::vector<T> tmp(SIZE);
-				std::vector<Key> tmpKey(SIZE);
-				Index curShift = 0;
-
-				while (len--)
+				switch (getDigitBits<T>(v.size(), len, options))
 				{
-					std::vector<Index> count(BASE);
-					std::vector<Index> prefix(BASE);
-
-					getCountVector(k, count, curShift, 0, SIZE, enableMultiThreading);
-					getPrefixVector<Key>(prefix, count, 0);
-					getSortedVector(v, k, tmp, tmpKey, prefix, curShift, 0, SIZE);
-
-					std::swap(v, tmp);
-					std::swap(k, tmpKey);
-
-					curShift += SHIFT_BITS;
+					case WIDE_DIGIT_BITS:
+						sortLsd<WIDE_DIGIT_BITS>(v, k, len, options);
+						break;
+					case MAX_DIGIT_BITS:
+						sortLsd<MAX_DIGIT_BITS>(v, k, len, options);
+						break;
+					default:
+						sortLsd<SHIFT_BITS>(v, k, len, options);
+						break;
 				}
 			}
 
 			template <typename T, typename Proj>
-			inline void sortMsd(std::vector<T>& v, Proj proj, std::vector<T>& tmp,
-				std::vector<Region>& regions, std::unique_lock<std::mutex>& lkRegions,
-				Region initialRegion, bool enableMultiThreading)
+			inline void sortMsd(std::span<T> v, Proj proj, std::span<T> tmp,
+				RegionScheduler& scheduler, Index workerIndex, MsdWorkspace& workspace,
+				Region initialRegion, const Options& options, bool enableMultiThreading)
 			{
 				using Key = sort_key<T, Proj>;
 
-				std::vector<Region> regionsLocal;
-				regionsLocal.reserve(v.size() / 100);
+				std::vector<Region>& regionsLocal = workspace.regions;
+				std::vector<Index>& count = workspace.count;
+				std::vector<Index>& prefix = workspace.prefix;
 				regionsLocal.emplace_back(initialRegion);
 
-				constexpr Index INSERTION_SORT_THRESHOLD = (std::same_as<Key, std::string>) ? INSERTION_SORT_THRESHOLD_STR : INSERTION_SORT_THRESHOLD_ALL;
-				constexpr Index ALLOC_SIZE = (std::same_as<Key, std::string>) ? CHARS_ALLOC : BASE;
+				const Index INSERTION_SORT_THRESHOLD = (std::same_as<Key, std::string>) ? options.insertionSortThresholdStr : options.insertionSortThresholdAll;
+
+				const auto moveBack = [&v, &tmp](Index start, Index end) {
+					std::move(tmp.begin() + start, tmp.begin() + end, v.begin() + start);
+				};
 
 				while (regionsLocal.size())
 				{
@@ -1228,20 +4570,31 @@ namespace radix_sort
 					Index r = region.r;
 					Index len = region.len;
 					Index curShiftOrIndex = region.curShiftOrIndex;
+					bool inTmp = region.inTmp;
 
+					// every level scatters into the other array, a region is only copied into v once it is final
 					if (r - l < 2 || len == 0)
+					{
+						if (inTmp)
+							moveBack(l, r);
 						continue;
+					}
 
 					if (r - l <= INSERTION_SORT_THRESHOLD)
 					{
+						if (inTmp)
+							moveBack(l, r);
 						insertionSort(v, proj, l, r);
 						continue;
 					}
 
 					if constexpr (is_string<Key>)
 					{
-						if (curShiftOrIndex >= STRING_MSD_MAX_DEPTH)
+						if (curShiftOrIndex >= options.stringMsdMaxDepth)
 						{
+							if (inTmp)
+								moveBack(l, r);
+
 							const auto LAMBDA = [&proj](const T& a, const T& b) {
 								return std::invoke(proj, a) < std::invoke(proj, b);
 							};
@@ -1254,35 +4607,81 @@ namespace radix_sort
 						}
 					}
 
-					std::vector<Index> count(ALLOC_SIZE);
-					std::vector<Index> prefix(ALLOC_SIZE);
+					std::span<T> src = (inTmp) ? tmp : v;
+					std::span<T> dst = (inTmp) ? v : tmp;
 
-					getCountVector(v, proj, count, curShiftOrIndex, l, r, enableMultiThreading);
-					getPrefixVector<Key>(prefix, count, l);
-					getSortedVector(v, proj, tmp, prefix, curShiftOrIndex, l, r);
+					std::fill(count.begin(), count.end(), 0);
 
-					std::move(tmp.begin() + l, tmp.begin() + r, v.begin() + l);
+					getCountVector(src, proj, workspace, curShiftOrIndex, l, r, options, enableMultiThreading);
+					getPrefixVector<Key>(prefix, count, l);
+					getSortedVector(src, proj, dst, prefix, curShiftOrIndex, l, r, getScatter<T>(r - l, options, true), workspace.isTmpRaw);
+					workspace.isTmpRaw = false;
 
+					// a region that still fits the caches is cheaper to copy back whole than to track bucket by bucket
 					len--;
+					bool childrenInTmp = !inTmp;
+					if (childrenInTmp && (len == 0 || (r - l) * sizeof(T) < MSD_COPY_BACK_THRESHOLD_BYTES))
+					{
+						moveBack(l, r);
+						childrenInTmp = false;
+					}
+
 					if (len == 0)
 						continue;
 
-					partitionRegions<Key>(count, regionsLocal, regions, lkRegions, len, curShiftOrIndex, l, enableMultiThreading);
+					if (childrenInTmp)
+						moveBackSettled<Key>(count, l, moveBack);
+
+					partitionRegions<Key>(count, regionsLocal, scheduler, workerIndex, len, curShiftOrIndex, l, childrenInTmp, options, enableMultiThreading);
+				}
+			}
+
+			// Sorts [l, r) of v and k by the len low bytes of k with an LSD alternating between them and the tmp arrays, meant for
+			// regions that fit the cache. Returns whether it ended in the tmp arrays.
+			template <typename T, typename Key>
+			inline bool sortLsdRegion(std::span<T> src, std::span<Key> srcKey, std::span<T> dst, std::span<Key> dstKey,
+				MsdWorkspace& workspace, Index len, Index l, Index r)
+			{
+				std::vector<Index>& counts = workspace.digitCounts;
+				counts.assign(len * BASE, 0);
+				getCountVectorsThread(srcKey, counts, len, l, r);
+
+				bool inDst = false;
+				for (Index digit = 0; digit < len; digit++)
+				{
+					if (isTrivialDigit(counts, digit, r - l))
+						continue;
+
+					std::copy_n(counts.begin() + digit * BASE, BASE, workspace.count.begin());
+					getPrefixVector<Key>(workspace.prefix, workspace.count, l);
+
+					if (inDst)
+						getSortedVector(dst, dstKey, src, srcKey, workspace.prefix, digit * SHIFT_BITS, l, r, Scatter::DIRECT);
+					else
+						getSortedVector(src, srcKey, dst, dstKey, workspace.prefix, digit * SHIFT_BITS, l, r, Scatter::DIRECT);
+					inDst = !inDst;
 				}
+
+				return inDst;
 			}
 
 			template <typename T, typename Key>
-			inline void sortMsd(std::vector<T>& v, std::vector<Key>& k,
-				std::vector<T>& tmp, std::vector<Key>& tmpKey,
-				std::vector<Region>& regions, std::unique_lock<std::mutex>& lkRegions,
-				Region initialRegion, bool enableMultiThreading)
+			inline void sortMsd(std::span<T> v, std::span<Key> k,
+				std::span<T> tmp, std::span<Key> tmpKey,
+				RegionScheduler& scheduler, Index workerIndex, MsdWorkspace& workspace,
+				Region initialRegion, const Options& options, bool enableMultiThreading)
 			{
-				std::vector<Region> regionsLocal;
-				regionsLocal.reserve(v.size() / 100);
+				std::vector<Region>& regionsLocal = workspace.regions;
+				std::vector<Index>& count = workspace.count;
+				std::vector<Index>& prefix = workspace.prefix;
 				regionsLocal.emplace_back(initialRegion);
 
-				constexpr Index INSERTION_SORT_THRESHOLD = (std::same_as<Key, std::string>) ? INSERTION_SORT_THRESHOLD_STR : INSERTION_SORT_THRESHOLD_ALL;
-				constexpr Index ALLOC_SIZE = (std::same_as<Key, std::string>) ? CHARS_ALLOC : BASE;
+				const Index INSERTION_SORT_THRESHOLD = (std::same_as<Key, std::string>) ? options.insertionSortThresholdStr : getSmallSortThreshold<Key>(options.insertionSortThresholdAll);
+
+				const auto moveBack = [&v, &k, &tmp, &tmpKey](Index start, Index end) {
+					std::move(tmp.begin() + start, tmp.begin() + end, v.begin() + start);
+					std::move(tmpKey.begin() + start, tmpKey.begin() + end, k.begin() + start);
+				};
 
 				while (regionsLocal.size())
 				{
@@ -1293,220 +4692,313 @@ namespace radix_sort
 					Index r = region.r;
 					Index len = region.len;
 					Index curShiftOrIndex = region.curShiftOrIndex;
+					bool inTmp = region.inTmp;
 
+					// every level scatters into the other arrays, a region is only copied into v and k once it is final
 					if (r - l < 2 || len == 0)
+					{
+						if (inTmp)
+							moveBack(l, r);
 						continue;
+					}
 
 					if (r - l <= INSERTION_SORT_THRESHOLD)
 					{
-						insertionSort(v, k, l, r);
+						if (inTmp)
+							moveBack(l, r);
+						sortSmall(v, k, l, r);
 						continue;
 					}
 
-					std::vector<Index> count(ALLOC_SIZE);
-					std::vector<Index> prefix(ALLOC_SIZE);
+					std::span<T> src = (inTmp) ? tmp : v;
+					std::span<T> dst = (inTmp) ? v : tmp;
+					std::span<Key> srcKey = (inTmp) ? tmpKey : k;
+					std::span<Key> dstKey = (inTmp) ? k : tmpKey;
 
-					getCountVector(k, count, curShiftOrIndex, l, r, enableMultiThreading);
-					getPrefixVector<Key>(prefix, count, l);
-					getSortedVector(v, k, tmp, tmpKey, prefix, curShiftOrIndex, l, r);
+					if constexpr (!is_string<Key>)
+					{
+						if ((r - l) * (sizeof(T) + sizeof(Key)) <= options.msdLsdThresholdBytes)
+						{
+							if (sortLsdRegion(src, srcKey, dst, dstKey, workspace, len, l, r) != inTmp)
+								moveBack(l, r);
+							continue;
+						}
+					}
+
+					std::fill(count.begin(), count.end(), 0);
 
-					std::move(tmp.begin() + l, tmp.begin() + r, v.begin() + l);
-					std::move(tmpKey.begin() + l, tmpKey.begin() + r, k.begin() + l);
+					getCountVector(srcKey, workspace, curShiftOrIndex, l, r, options, enableMultiThreading);
+					getPrefixVector<Key>(prefix, count, l);
+					getSortedVector(src, srcKey, dst, dstKey, prefix, curShiftOrIndex, l, r, getScatter<T>(r - l, options, true));
 
+					// a region that still fits the caches is cheaper to copy back whole than to track bucket by bucket
 					len--;
+					bool childrenInTmp = !inTmp;
+					if (childrenInTmp && (len == 0 || (r - l) * sizeof(T) < MSD_COPY_BACK_THRESHOLD_BYTES))
+					{
+						moveBack(l, r);
+						childrenInTmp = false;
+					}
+
 					if (len == 0)
 						continue;
 
-					partitionRegions<Key>(count, regionsLocal, regions, lkRegions, len, curShiftOrIndex, l, enableMultiThreading);
+					if (childrenInTmp)
+						moveBackSettled<Key>(count, l, moveBack);
+
+					partitionRegions<Key>(count, regionsLocal, scheduler, workerIndex, len, curShiftOrIndex, l, childrenInTmp, options, enableMultiThreading);
 				}
 			}
 
 			template <typename T, typename Proj>
-			inline void sortMsdThread(std::vector<T>& v, Proj proj, std::vector<T>& tmp,
-				std::vector<Region>& regions, std::mutex& regionsLock,
-				Index& runningCounter, Index threadIndex)
+			inline void sortMsdThread(std::span<T> v, Proj proj, std::span<T> tmp,
+				RegionScheduler& scheduler, Index threadIndex, const Options& options)
 			{
-				std::unique_lock<std::mutex> lkRegions(regionsLock, std::defer_lock);
-
-				bool isIdle = false;
+				Region region;
+				MsdWorkspace workspace((is_string<sort_key<T, Proj>>) ? CHARS_ALLOC : BASE);
 				Index iterationsIdle = 0;
 
 				while (true)
 				{
-					lkRegions.lock();
-					if (regions.size())
+					if (scheduler.acquire(threadIndex, region))
 					{
-						Region region = std::move(regions.back());
-						regions.pop_back();
-
-						if (isIdle)
-						{
-							isIdle = false;
-							runningCounter++;
-							iterationsIdle = 0;
-						}
-
-						lkRegions.unlock();
-						sortMsd(v, proj, tmp, regions, lkRegions, region, 1);
+						iterationsIdle = 0;
+						sortMsd(v, proj, tmp, scheduler, threadIndex, workspace, region, options, true);
+						scheduler.complete();
 					}
 					else
 					{
-						if (!isIdle)
-						{
-							isIdle = true;
-							runningCounter--;
-						}
-
-						if (runningCounter == 0)
-						{
-							lkRegions.unlock();
+						if (scheduler.finished())
 							break;
-						}
 
-						lkRegions.unlock();
 						iterationsIdle++;
 
-						if (iterationsIdle > SLEEP_ITERATIONS_THRESHOLD)
+						if (iterationsIdle > SPIN_ITERATIONS_THRESHOLD)
 						{
 							iterationsIdle = 0;
-							std::this_thread::sleep_for(std::chrono::nanoseconds(1));
+							scheduler.park();
 						}
 					}
 				}
 			}
 
 			template <typename T, typename Key>
-			inline void sortMsdThread(std::vector<T>& v, std::vector<Key>& k,
-				std::vector<T>& tmp, std::vector<Key>& tmpKey,
-				std::vector<Region>& regions, std::mutex& regionsLock,
-				Index& runningCounter, Index threadIndex)
+			inline void sortMsdThread(std::span<T> v, std::span<Key> k,
+				std::span<T> tmp, std::span<Key> tmpKey,
+				RegionScheduler& scheduler, Index threadIndex, const Options& options)
 			{
-				std::unique_lock<std::mutex> lkRegions(regionsLock, std::defer_lock);
-
-				bool isIdle = false;
+				Region region;
+				MsdWorkspace workspace((is_string<Key>) ? CHARS_ALLOC : BASE);
 				Index iterationsIdle = 0;
 
 				while (true)
 				{
-					lkRegions.lock();
-					if (regions.size())
+					if (scheduler.acquire(threadIndex, region))
 					{
-						Region region = std::move(regions.back());
-						regions.pop_back();
-
-						if (isIdle)
-						{
-							isIdle = false;
-							runningCounter++;
-							iterationsIdle = 0;
-						}
-
-						lkRegions.unlock();
-						sortMsd(v, k, tmp, tmpKey, regions, lkRegions, region, 1);
+						iterationsIdle = 0;
+						sortMsd(v, k, tmp, tmpKey, scheduler, threadIndex, workspace, region, options, true);
+						scheduler.complete();
 					}
 					else
 					{
-						if (!isIdle)
-						{
-							isIdle = true;
-							runningCounter--;
-						}
-
-						if (runningCounter == 0)
-						{
-							lkRegions.unlock();
+						if (scheduler.finished())
 							break;
-						}
 
-						lkRegions.unlock();
 						iterationsIdle++;
 
-						if (iterationsIdle > SLEEP_ITERATIONS_THRESHOLD)
+						if (iterationsIdle > SPIN_ITERATIONS_THRESHOLD)
 						{
 							iterationsIdle = 0;
-							std::this_thread::sleep_for(std::chrono::nanoseconds(1));
+							scheduler.park();
 						}
 					}
 				}
 			}
 
 			template <typename T, typename Proj>
-			inline void sortMsdInit(std::vector<T>& v, Proj proj, Index len, bool enableMultiThreading)
+			inline void sortMsdInit(std::span<T> v, Proj proj, Index len, const Options& options)
 			{
 				using Key = sort_key<T, Proj>;
 
 				const Index SIZE = v.size();
-				std::vector<T> tmp(SIZE);
 				Index curShiftOrIndex = (is_string<Key>) ? 0 : (len - 1) * 8;
-				Index numOfThreads = getNumOfThreads(SIZE);
+				Index numOfThreads = getNumOfThreads(SIZE, options);
+				ScratchBuffer<T> scratch(SIZE, (options.enableMultiThreading) ? numOfThreads : 1, getArena(options));
+				std::span<T> tmp = scratch.span();
 
-				if (!enableMultiThreading || numOfThreads <= 1)
+				if (!options.enableMultiThreading || numOfThreads <= 1)
 				{
-					std::mutex tmpMutex;
-					std::unique_lock<std::mutex> tmpLock(tmpMutex, std::defer_lock);
+					RegionScheduler tmpScheduler(1);
+					MsdWorkspace workspace((is_string<Key>) ? CHARS_ALLOC : BASE);
+					workspace.isTmpRaw = scratch.isRaw();
+					sortMsd(v, proj, tmp, tmpScheduler, 0, workspace, Region(0, SIZE, len, curShiftOrIndex), options, false);
 
-					std::vector<Region> tmpVector;
-					sortMsd(v, proj, tmp, tmpVector, tmpLock, Region(0, SIZE, len, curShiftOrIndex), false);
+					if (!workspace.isTmpRaw)
+						scratch.setConstructed();
 				}
 				else
 				{
-					std::vector<std::thread> threads;
-					std::mutex regionsLock;
-					Index runningCounter = numOfThreads;
-
-					std::vector<Region> regions;
-					regions.reserve(1000);
-					regions.emplace_back(0, SIZE, len, curShiftOrIndex);
-					
-					for (Index i = 0; i < numOfThreads; i++)
-					{
-						threads.emplace_back([&v, &proj, &tmp, &regions, &regionsLock, &runningCounter, i]() {
-							sortMsdThread(v, proj, tmp, regions, regionsLock, runningCounter, i);
+					RegionScheduler scheduler(numOfThreads);
+					const Scatter SCATTER = getScatter<T>(SIZE, options, true);
+
+					bool isTmpRaw = partitionTopLevels<Key>(scheduler, numOfThreads, Region(0, SIZE, len, curShiftOrIndex), scratch.isRaw(), options,
+						[&v, &proj, &tmp](std::vector<Index>& chunkCount, Index curShiftOrIndex, bool inTmp, Index start, Index end) {
+							getCountVectorThread((inTmp) ? tmp : v, proj, chunkCount, curShiftOrIndex, start, end);
+						},
+						[&v, &proj, &tmp, SCATTER](std::vector<Index>& chunkPrefix, Index curShiftOrIndex, bool inTmp, bool construct, Index start, Index end) {
+							getSortedVector((inTmp) ? tmp : v, proj, (inTmp) ? v : tmp, chunkPrefix, curShiftOrIndex, start, end, SCATTER, construct);
+						},
+						[&v, &tmp](Index start, Index end) {
+							std::move(tmp.begin() + start, tmp.begin() + end, v.begin() + start);
 						});
-					}
 
-					for (auto& t : threads)
-						t.join();
+					// workers only scatter into constructed slots, a top level they sort themselves needs tmp built first
+					if (isTmpRaw)
+						scratch.construct();
+					else
+						scratch.setConstructed();
+
+					ThreadPool::instance().run(numOfThreads, [&v, &proj, &tmp, &scheduler, &options](Index i, Index) {
+						sortMsdThread(v, proj, tmp, scheduler, i, options);
+					});
 				}
 			}
 
 			template <typename T, typename Key>
-			inline void sortMsdInit(std::vector<T>& v, std::vector<Key>& k, Index len, bool enableMultiThreading)
+			inline void sortMsdInit(std::span<T> v, std::span<Key> k, Index len, const Options& options)
 			{
 				const Index SIZE = v.size();
-				std::vector<T> tmp(SIZE);
-				std::vector<Key> tmpKey(SIZE);
 				Index curShiftOrIndex = (is_string<Key>) ? 0 : (len - 1) * 8;
-				Index numOfThreads = getNumOfThreads(SIZE);
+				Index numOfThreads = getNumOfThreads(SIZE, options);
+				ScratchBuffer<T> scratch(SIZE, (options.enableMultiThreading) ? numOfThreads : 1, getArena(options));
+				ScratchBuffer<Key> scratchKey(SIZE, (options.enableMultiThreading) ? numOfThreads : 1, getArena(options));
+				std::span<T> tmp = scratch.span();
+				std::span<Key> tmpKey = scratchKey.span();
 
-				if (!enableMultiThreading || numOfThreads <= 1)
+				if (!options.enableMultiThreading || numOfThreads <= 1)
 				{
-					std::mutex tmpMutex;
-					std::unique_lock<std::mutex> tmpLock(tmpMutex, std::defer_lock);
-
-					std::vector<Region> tmpVector;
-					sortMsd(v, k, tmp, tmpKey, tmpVector, tmpLock, Region(0, SIZE, len, curShiftOrIndex), false);
+					RegionScheduler tmpScheduler(1);
+					MsdWorkspace workspace((is_string<Key>) ? CHARS_ALLOC : BASE);
+					sortMsd(v, k, tmp, tmpKey, tmpScheduler, 0, workspace, Region(0, SIZE, len, curShiftOrIndex), options, false);
 				}
 				else
 				{
-					std::vector<std::thread> threads;
-					std::mutex regionsLock;
-					Index runningCounter = numOfThreads;
+					RegionScheduler scheduler(numOfThreads);
+					const Scatter SCATTER = getScatter<T>(SIZE, options, true);
+
+					partitionTopLevels<Key>(scheduler, numOfThreads, Region(0, SIZE, len, curShiftOrIndex), false, options,
+						[&k, &tmpKey](std::vector<Index>& chunkCount, Index curShiftOrIndex, bool inTmp, Index start, Index end) {
+							getCountVectorThread((inTmp) ? tmpKey : k, chunkCount, curShiftOrIndex, start, end);
+						},
+						[&v, &k, &tmp, &tmpKey, SCATTER](std::vector<Index>& chunkPrefix, Index curShiftOrIndex, bool inTmp, bool, Index start, Index end) {
+							if (inTmp)
+								getSortedVector(tmp, tmpKey, v, k, chunkPrefix, curShiftOrIndex, start, end, SCATTER);
+							else
+								getSortedVector(v, k, tmp, tmpKey, chunkPrefix, curShiftOrIndex, start, end, SCATTER);
+						},
+						[&v, &k, &tmp, &tmpKey](Index start, Index end) {
+							std::move(tmp.begin() + start, tmp.begin() + end, v.begin() + start);
+							std::move(tmpKey.begin() + start, tmpKey.begin() + end, k.begin() + start);
+						});
+
+					ThreadPool::instance().run(numOfThreads, [&v, &k, &tmp, &tmpKey, &scheduler, &options](Index i, Index) {
+						sortMsdThread(v, k, tmp, tmpKey, scheduler, i, options);
+					});
+				}
+			}
 
-					std::vector<Region> regions;
-					regions.reserve(1000);
-					regions.emplace_back(0, SIZE, len, curShiftOrIndex);
+			template <typename T, typename Proj>
+			inline void sortCounting(std::span<T> v, Proj proj, const Report& report, const Options& options)
+			{
+				const Index SIZE = v.size();
+				ScratchBuffer<T> scratch(SIZE, 1, getArena(options));
+				std::span<T> tmp = scratch.span();
+				std::vector<Index> prefix(report.keyRange);
+
+				for (const auto& obj : v)
+					prefix[getOrderedBits(std::invoke(proj, obj)) - report.minKey]++;
+
+				std::exclusive_scan(prefix.begin(), prefix.end(), prefix.begin(), static_cast<Index>(0));
+
+				bool construct = scratch.isRaw();
+				for (auto& obj : v)
+					putItem(tmp, prefix[getOrderedBits(std::invoke(proj, obj)) - report.minKey]++, std::move(obj), construct);
+
+				scratch.setConstructed();
+				moveBuffer(tmp, v, 1);
+			}
 
-					for (Index i = 0; i < numOfThreads; i++)
+			// the items themselves are permuted, no index or key arrays, equal keys do not keep their order;
+			// items the block buffers cannot hold are sorted by one thread
+			template <typename T, typename Proj>
+			inline void sortInPlace(std::span<T> v, Proj proj, Index len, const Options& options)
+			{
+				const Index NUM_OF_THREADS = (options.enableMultiThreading) ? getNumOfThreads(v.size(), options) : 1;
+				auto getBits = [&proj](const T& obj) {
+					return getOrderedBits(std::invoke(proj, obj));
+				};
+
+				if constexpr (is_block_movable<T>)
+				{
+					if (NUM_OF_THREADS > 1 || v.size() >= options.parallelScatterThreshold)
 					{
-						threads.emplace_back([&v, &k, &tmp, &tmpKey, &regions, &regionsLock, &runningCounter, i]() {
-							sortMsdThread(v, k, tmp, tmpKey, regions, regionsLock, runningCounter, i);
-						});
+						sortInPlaceBlocks(v, len, options, NUM_OF_THREADS, getBits);
+						return;
 					}
-
-					for (auto& t : threads)
-						t.join();
 				}
+
+				sortInPlaceMsd(v, len, options, getBits);
+			}
+
+			// like sortLsd, only v has to end up sorted, k is the caller's key scratch
+			template <typename T, typename Key>
+			inline void sortCounting(std::span<T> v, std::span<Key> k, const Report& report, const Options& options)
+			{
+				const Index SIZE = v.size();
+				ScratchBuffer<T> scratch(SIZE, 1, getArena(options));
+				std::span<T> tmp = scratch.span();
+				std::vector<Index> prefix(report.keyRange);
+
+				for (const auto& key : k)
+					prefix[getOrderedBits(key) - report.minKey]++;
+
+				std::exclusive_scan(prefix.begin(), prefix.end(), prefix.begin(), static_cast<Index>(0));
+
+				for (Index i = 0; i < SIZE; i++)
+					tmp[prefix[getOrderedBits(k[i]) - report.minKey]++] = std::move(v[i]);
+
+				moveBuffer(tmp, v, 1);
+			}
+
+			// stable, so projected types keep their guarantee; floating point keys are ordered like the radix passes order them
+			template <typename T, typename Proj>
+			inline void sortComparison(std::span<T> v, Proj proj, const Options& options)
+			{
+				using Key = sort_key<T, Proj>;
+
+				auto comp = [&proj](const T& a, const T& b) {
+					if constexpr (is_floating_point<Key>)
+						return std::strong_order(std::invoke(proj, a), std::invoke(proj, b)) < 0;
+					else
+						return std::invoke(proj, a) < std::invoke(proj, b);
+				};
+
+				if (options.enableMultiThreading && getNumOfThreads(v.size(), options) > 1)
+					std::stable_sort(std::execution::par, v.begin(), v.end(), comp);
+				else
+					std::stable_sort(v.begin(), v.end(), comp);
+			}
+
+			// v still holds the positions of its keys in k (the indices before sorting)
+			template <typename I, typename Key>
+			inline void sortComparison(std::span<I> v, std::span<Key> k, const Options& options)
+			{
+				auto comp = [&k](const I& a, const I& b) { return k[a] < k[b]; };
+
+				if (options.enableMultiThreading && getNumOfThreads(v.size(), options) > 1)
+					std::stable_sort(std::execution::par, v.begin(), v.end(), comp);
+				else
+					std::stable_sort(v.begin(), v.end(), comp);
 			}
 
 			// =====================
@@ -1514,86 +5006,174 @@ namespace radix_sort
 			// =====================
 
 			template <typename T, typename Proj>
-			inline void selectSortStrategy(std::vector<T>& v, Proj proj, Index len, bool enableMultiThreading)
+			inline void selectSortStrategy(std::span<T> v, Proj proj, Index len, const Options& options)
 			{
 				using Key = sort_key<T, Proj>;
-				Index numOfThreads = getNumOfThreads(v.size());
+				Report report = planStrategy<Key>(v.size(), len, options, [&v, &proj](Index i) -> decltype(auto) { return std::invoke(proj, v[i]); });
 
-				if (is_string<Key> || (is_large_integral<Key> && len > 1))
-					sortMsdInit(v, proj, len, enableMultiThreading);
-				else if (is_small_integral<Key> || len <= 1 || !enableMultiThreading || numOfThreads <= 1)
-					sortLsd(v, proj, len, enableMultiThreading);
-				else
-					sortMsdInit(v, proj, len, enableMultiThreading);
+				switch (report.strategy)
+				{
+					case Strategy::LSD:
+						if constexpr (!is_string<Key>)
+							sortLsdInit(v, proj, len, options);
+						break;
+					case Strategy::COUNTING:
+						if constexpr (!is_string<Key>)
+							sortCounting(v, proj, report, options);
+						break;
+					case Strategy::COMPARISON:
+						sortComparison(v, proj, options);
+						break;
+					default:
+						sortMsdInit(v, proj, len, options);
+						break;
+				}
+
+				setReport(options, std::move(report));
 			}
 
 			template <typename T, typename Key>
-			inline void selectSortStrategy(std::vector<T>& v, std::vector<Key>& k, Index len, bool enableMultiThreading)
+			inline void selectSortStrategy(std::span<T> v, std::span<Key> k, Index len, const Options& options)
 			{
-				Index numOfThreads = getNumOfThreads(v.size());
+				Report report = planStrategy<Key>(v.size(), len, options, [&k](Index i) -> const Key& { return k[i]; });
 
-				if (is_string<Key> || (is_large_integral<Key> && len > 1))
-					sortMsdInit(v, k, len, enableMultiThreading);
-				else if (is_small_integral<Key> || len <= 1 || !enableMultiThreading || numOfThreads <= 1)
-					sortLsd(v, k, len, enableMultiThreading);
-				else
-					sortMsdInit(v, k, len, enableMultiThreading);
+				switch (report.strategy)
+				{
+					case Strategy::LSD:
+						if constexpr (!is_string<Key>)
+							sortLsdInit(v, k, len, options);
+						break;
+					case Strategy::COUNTING:
+						if constexpr (!is_string<Key>)
+							sortCounting(v, k, report, options);
+						break;
+					case Strategy::COMPARISON:
+						sortComparison(v, k, options);
+						break;
+					default:
+						sortMsdInit(v, k, len, options);
+						break;
+				}
+
+				setReport(options, std::move(report));
 			}
 
-			template <typename T, typename Proj>
-			inline void selectProjStrategy(std::vector<T>& v, Proj proj, bool enableMultiThreading)
+			// Sorts the positions of v's keys (indices of type I, narrow when the size fits) by those keys and gathers v after them.
+			template <typename I, typename T, typename Proj>
+			inline void sortByKeys(std::vector<T>& v, Proj proj, Index len, const Options& options)
 			{
 				using Key = sort_key<T, Proj>;
 				const Index SIZE = v.size();
-				Index len = getMaxLength(v, proj);
-				
+
 				if constexpr (is_floating_point<Key>)
 				{
-					std::vector<t2u<Key>> vu(SIZE);
-					std::vector<Index> indices(SIZE);
-					std::iota(indices.begin(), indices.end(), static_cast<Index>(0));
+					ScratchBuffer<t2u<Key>> vu(SIZE, (options.enableMultiThreading) ? getNumOfThreads(SIZE, options) : 1, getArena(options));
+					ScratchBuffer<I> indices(SIZE, 1, getArena(options));
+					std::iota(indices.span().begin(), indices.span().end(), static_cast<I>(0));
 
-					getUnsignedVector(v, proj, vu, enableMultiThreading);
-					selectSortStrategy(indices, vu, len, enableMultiThreading);
-					sortByIndices(v, indices, enableMultiThreading);
+					getUnsignedVector(v, proj, vu.span(), options);
+					selectSortStrategy(indices.span(), vu.span(), len, options);
+					sortByIndices(v, indices.span(), options);
 				}
 				else
 				{
-					constexpr Index COMPLEX_SIZE = sizeof(T);
-					constexpr Index INDEX_SIZE = sizeof(Index);
+					ScratchBuffer<I> indices(SIZE, 1, getArena(options));
+					std::iota(indices.span().begin(), indices.span().end(), static_cast<I>(0));
 
-					if (COMPLEX_SIZE <= INDEX_SIZE || len <= 1)
+					if constexpr (is_string<Key>)
 					{
-						selectSortStrategy(v, proj, len, enableMultiThreading);
-						return;
+						auto tmpFunc = [&v, &proj](const I& i) -> const Key& { return std::invoke(proj, v[i]); };
+						selectSortStrategy(indices.span(), tmpFunc, len, options);
 					}
+					else
+					{
+						ScratchBuffer<Key> k(SIZE, 1, getArena(options));
+						std::span<Key> keys = k.span();
 
-					std::vector<Index> indices(SIZE);
-					std::iota(indices.begin(), indices.end(), static_cast<Index>(0));
+						for (Index i = 0; i < SIZE; i++)
+							keys[i] = std::invoke(proj, v[i]);
 
-					if constexpr (is_string<Key>)
-					{
-						auto tmpFunc = [&v, &proj](const Index& i) -> const Key& { return std::invoke(proj, v[i]); };
-						selectSortStrategy(indices, tmpFunc, len, enableMultiThreading);
+						selectSortStrategy(indices.span(), keys, len, options);
 					}
-					else
+
+					sortByIndices(v, indices.span(), options);
+				}
+			}
+
+			template <typename T, typename Proj>
+			inline void selectProjStrategy(std::vector<T>& v, Proj proj, const Options& options)
+			{
+				using Key = sort_key<T, Proj>;
+				const Index SIZE = v.size();
+
+				if (options.strategy == Strategy::COMPARISON)
+				{
+					sortComparison(std::span<T>(v), proj, options);
+					setReport(options, { Strategy::COMPARISON, "forced by options" });
+					return;
+				}
+
+				Index len = getMaxLength(v, proj);
+
+				if constexpr (!is_string<Key>)
+				{
+					if (options.strategy == Strategy::IN_PLACE)
 					{
-						std::vector<Key> k;
-						k.reserve(SIZE);
+						sortInPlace(std::span<T>(v), proj, len, options);
+						setReport(options, { Strategy::IN_PLACE, "forced by options" });
+						return;
+					}
+				}
 
-						for (const auto& obj : v)
-							k.emplace_back(std::invoke(proj, obj));
+				// scratch of sorting T directly (tmp) and of sorting indices (keys, indices and their tmps, plus the final gather)
+				const bool IS_SMALL_INDEX = SIZE <= SMALL_INDEX_LIMIT;
+				const Index DIRECT_SCRATCH_BYTES = SIZE * sizeof(T);
+				const Index INDEX_SCRATCH_BYTES = SIZE * (2 * ((IS_SMALL_INDEX) ? sizeof(SmallIndex) : sizeof(Index)) + sizeof(T) + ((is_string<Key>) ? 0 : 2 * sizeof(Key)));
 
-						selectSortStrategy(indices, k, len, enableMultiThreading);
+				if constexpr (is_floating_point<Key>)
+				{
+					if (INDEX_SCRATCH_BYTES > options.maxScratchBytes)
+					{
+						sortInPlace(std::span<T>(v), proj, len, options);
+						setReport(options, { Strategy::IN_PLACE, "radix scratch exceeds maxScratchBytes" });
+						return;
 					}
+				}
+				else
+				{
+					constexpr Index COMPLEX_SIZE = sizeof(T);
+					constexpr Index INDEX_SIZE = sizeof(Index);
 
-					sortByIndices(v, indices, enableMultiThreading);
+					if (COMPLEX_SIZE <= INDEX_SIZE || len <= 1 || INDEX_SCRATCH_BYTES > options.maxScratchBytes)
+					{
+						if (DIRECT_SCRATCH_BYTES > options.maxScratchBytes)
+						{
+							if constexpr (is_string<Key>)
+							{
+								sortComparison(std::span<T>(v), proj, options);
+								setReport(options, { Strategy::COMPARISON, "radix scratch exceeds maxScratchBytes" });
+							}
+							else
+							{
+								sortInPlace(std::span<T>(v), proj, len, options);
+								setReport(options, { Strategy::IN_PLACE, "radix scratch exceeds maxScratchBytes" });
+							}
+						}
+						else
+							selectSortStrategy(std::span<T>(v), proj, len, options);
+						return;
+					}
 				}
+
+				if (IS_SMALL_INDEX)
+					sortByKeys<SmallIndex>(v, proj, len, options);
+				else
+					sortByKeys<Index>(v, proj, len, options);
 			}
 
 			template <typename T, typename Proj>
 			requires sortable<T, Proj>
-			inline void sortDispatcher(std::vector<T>& v, Proj proj, bool enableMultiThreading)
+			inline void sortDispatcher(std::vector<T>& v, Proj proj, const Options& options)
 			{
 				using Key = sort_key<T, Proj>;
 
@@ -1605,18 +5185,23 @@ namespace radix_sort
 					);
 				}
 
-				if (isSorted(v, proj))
+				bool isPlanned = options.plan && options.plan->covers(v.size()) && options.plan->decision.strategy != Strategy::COMPARISON;
+				if (!isPlanned && isSorted(v, proj))
+				{
+					setReport(options, { Strategy::AUTO, "already sorted" });
 					return;
+				}
 
 				const Index SIZE = v.size();
-				constexpr Index INSERTION_SORT_THRESHOLD = (is_string<Key>) ? INSERTION_SORT_THRESHOLD_STR : INSERTION_SORT_THRESHOLD_ALL;
+				const Index INSERTION_SORT_THRESHOLD = (is_string<Key>) ? options.insertionSortThresholdStr : options.insertionSortThresholdAll;
 				if (SIZE <= INSERTION_SORT_THRESHOLD)
 				{
-					insertionSort(v, proj, 0, SIZE);
+					insertionSort(std::span<T>(v), proj, 0, SIZE);
+					setReport(options, { Strategy::AUTO, "insertion sort below threshold" });
 					return;
 				}
 
-				selectProjStrategy(v, proj, enableMultiThreading);
+				selectProjStrategy(v, proj, options);
 			}
 		}
 	}
@@ -1625,8 +5210,49 @@ namespace radix_sort
 	// -----API-----
 	// =============
 
+	// Caps the number of threads (the caller included) that parallel sorts may use across the whole process.
+	inline void set_max_threads(std::size_t numOfThreads)
+	{
+		internal::shared::maxConcurrency.store(std::max<std::size_t>(numOfThreads, 1), std::memory_order_relaxed);
+	}
+
+	// Pins pool workers to cpus and places large scratch buffers by first touch (with huge pages where available),
+	// so on multi-socket machines every thread scatters into memory local to its own node.
+	inline void set_numa_awareness(bool enabled)
+	{
+		internal::shared::numaAwareness.store(enabled, std::memory_order_relaxed);
+		internal::shared::ThreadPool::instance().setAffinity(enabled);
+	}
+
+	// Per-call tuning (thread count, thresholds, forced strategy, scratch memory limit), defaults match the plain overloads.
+	using options = internal::shared::Options;
+	using strategy = internal::shared::Strategy;
+	using scatter = internal::shared::Scatter;
+	using report = internal::shared::Report;
+
+	// Scratch memory kept across sorts: set options::workspace to it and every sort borrows its tmp, key and index buffers
+	// from it instead of allocating and faulting in fresh ones. Blocks are raw bytes grown on demand, so one workspace
+	// serves any element type, size() reports what it holds and clear() gives it back. One sort at a time per workspace.
+	using workspace = internal::shared::ScratchArena;
+
+	// Options tuned for T's sort key by the machine profile (see radix_sort::calibrate), a starting point for per-call tweaks.
 	template <typename T, typename Proj = std::identity>
-	inline void sort(std::vector<T>& v, Proj proj = {}, bool enableMultiThreading = false)
+	inline options default_options()
+	{
+		if constexpr (std::is_invocable_v<Proj&, const T&>)
+			return internal::shared::getProfileOptions<internal::shared::sort_key<T, Proj>>();
+		else
+			return options{};
+	}
+
+	// Replaces the thresholds of the running process with the profile at path, false if it is missing or malformed.
+	inline bool load_profile(const std::string& path)
+	{
+		return internal::shared::Profile::instance().load(path);
+	}
+
+	template <typename T, typename Proj = std::identity>
+	inline void sort(std::vector<T>& v, Proj proj, const options& opts)
 	{
 		if constexpr (std::same_as<std::remove_cvref_t<Proj>, std::identity>)
 		{
@@ -1635,7 +5261,7 @@ namespace radix_sort
 				"ERROR: Unable to sort vector! CAUSE: Unsupported type!"
 			);
 
-			internal::value::sortDispatcher(v, enableMultiThreading);
+			internal::value::sortDispatcher(v, opts);
 		}
 		else
 		{
@@ -1644,7 +5270,85 @@ namespace radix_sort
 				"ERROR: Unable to sort vector! CAUSE: Key extractor is invalid or returns an unsupported type!"
 			);
 
-			internal::key::sortDispatcher(v, proj, enableMultiThreading);
+			internal::key::sortDispatcher(v, proj, opts);
 		}
 	}
+
+	template <typename T>
+	inline void sort(std::vector<T>& v, const options& opts)
+	{
+		sort(v, std::identity{}, opts);
+	}
+
+	template <typename T, typename Proj = std::identity>
+	inline void sort(std::vector<T>& v, Proj proj = {}, bool enableMultiThreading = false)
+	{
+		options opts = default_options<T, Proj>();
+		opts.enableMultiThreading = enableMultiThreading;
+		sort(v, proj, opts);
+	}
+
+	// Reusable decisions for sorting many batches of one type and projection with sizes in one size class (same bit width).
+	// The first execute samples the keys and picks the engine, later ones skip the sortedness scan and the sampling,
+	// replay that choice and reuse the scratch memory it allocated. The choice is remade whenever a batch leaves the
+	// size class, has a different key length or no longer fits counting sort's key range. One execute at a time per plan.
+	template <typename T, typename Proj = std::identity>
+	class plan
+	{
+	public:
+		explicit plan(Proj proj = {}, const options& opts = default_options<T, Proj>())
+			: proj(proj), opts(opts), state(std::make_unique<internal::shared::Plan>())
+		{
+			this->opts.plan = state.get();
+		}
+
+		explicit plan(const options& opts) : plan(Proj{}, opts) {}
+
+		void execute(std::vector<T>& v)
+		{
+			sort(v, proj, opts);
+		}
+
+		// human readable summary of the current decision, for logs and debugging
+		std::string explain() const
+		{
+			using namespace internal::shared;
+
+			const Report& decision = state->decision;
+			if (decision.strategy == Strategy::AUTO)
+				return "not planned yet (no batch has reached a radix engine)";
+
+			constexpr std::array<const char*, 6> NAMES = { "auto", "LSD radix sort", "MSD radix sort", "counting sort", "comparison sort", "in-place MSD radix sort" };
+
+			std::ostringstream out;
+			out << NAMES[static_cast<Index>(decision.strategy)]
+				<< " for sizes in [" << (static_cast<Index>(1) << (state->sizeClass - 1)) << ", " << ((static_cast<Index>(1) << (state->sizeClass - 1)) * 2 - 1) << "]"
+				<< ", " << decision.keyLength << ((is_string<sort_key<T, Proj>>) ? " key characters" : " key bytes")
+				<< ", " << decision.numOfThreads << ((decision.numOfThreads == 1) ? " thread" : " threads") << "\n"
+				<< "reason: " << decision.reason << "\n";
+
+			if (decision.sampleSize)
+			{
+				out << "sample: " << decision.sampleSize << " keys, " << decision.distinctKeys << " distinct, "
+					<< getPercent(decision.presortedness) << " in order, entropy per byte (high to low):";
+
+				for (Index byte = decision.keyLength; byte-- > 0; )
+					out << " " << std::round(decision.entropy[byte] * 100.0) / 100.0;
+
+				out << "\n";
+			}
+
+			if (decision.strategy == Strategy::COUNTING)
+				out << "key range: " << decision.keyRange << " values\n";
+
+			out << "scratch kept: " << state->arena.size() << " bytes";
+
+			return out.str();
+		}
+
+	private:
+		Proj proj;
+		options opts;
+		std::unique_ptr<internal::shared::Plan> state;
+	};
 };